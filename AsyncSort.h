@@ -0,0 +1,524 @@
+/*
+	This is the AsyncSort.h header file.
+	This file contains sortAsync, which sorts on a shared pool of worker
+	threads instead of blocking the calling thread.
+
+	sortAsync returns a SortFuture right away. The caller can wait on it,
+	check the progress of the sort, or cancel it. A sort can also be given a
+	stop token or a deadline in its SortPolicy. In C++20 a SortFuture can be
+	co_awaited; the coroutine resumes on the pool thread that finished the sort.
+
+	The pool has one thread per core. Small sorts are queued like any other,
+	but a worker takes a batch of queued small sorts at once and runs them
+	back to back, so many concurrent small sorts never start extra threads.
+*/
+
+#ifndef ASYNC_SORT_H
+#define ASYNC_SORT_H
+
+#include "Sort.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+using namespace std;
+
+/**
+ * Sorts smaller than this are run in batches by the pool.
+ */
+const int ASYNC_SMALL_SORT = 4096;
+
+/**
+ * Most small sorts a worker takes from the queue at once.
+ */
+const int ASYNC_BATCH_SIZE = 64;
+
+/**
+ * Thrown by SortFuture::get when the sort was cancelled or ran past its deadline.
+ */
+class SortCancelled : public runtime_error
+{
+public:
+	explicit SortCancelled(bool deadline)
+		: runtime_error(deadline ? "sort deadline exceeded" : "sort cancelled"), deadlineExceeded(deadline)
+	{
+	}
+
+	bool deadlineExceeded;
+};
+
+/**
+ * A shared stop flag. Copies of a token share the flag, so a copy kept by
+ * the caller can stop a sort that was given another copy.
+ */
+class SortStopToken
+{
+public:
+	SortStopToken() : flag(make_shared<atomic<bool>>(false)) {}
+
+	void requestStop() { flag->store(true, memory_order_relaxed); }
+	bool stopRequested() const { return flag->load(memory_order_relaxed); }
+
+private:
+	shared_ptr<atomic<bool>> flag;
+};
+
+/**
+ * The sorting algorithm used by sortAsync.
+ */
+enum class SortAlgorithm
+{
+	Quicksort,	// Not stable
+	MergeSort	// Stable
+};
+
+/**
+ * How sortAsync runs a sort.
+ */
+struct SortPolicy
+{
+	SortAlgorithm algorithm = SortAlgorithm::Quicksort;
+	SortStopToken stop;
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+};
+
+/**
+ * The state of an asynchronous sort.
+ */
+enum class SortStatus
+{
+	Queued,
+	Running,
+	Done,
+	Cancelled,
+	DeadlineExceeded,
+	Failed
+};
+
+/**
+ * Internal state shared by a running sort and its SortFuture.
+ */
+struct SortState
+{
+	mutex lock;
+	condition_variable finished;
+	SortStatus status = SortStatus::Queued;
+	exception_ptr error;
+	function<void()> continuation;
+
+	SortStopToken stop;
+	chrono::steady_clock::time_point deadline;
+	int checks = 0;
+
+	atomic<long long> done{ 0 };
+	long long total = 0;
+
+	bool isFinished() const { return status != SortStatus::Queued && status != SortStatus::Running; }
+};
+
+/**
+ * Internal method for the asynchronous sorts.
+ * Throws SortCancelled if the sort has been stopped or is past its deadline.
+ * The clock is only read on every 64th call.
+ */
+inline void checkpoint(SortState& state)
+{
+	if (state.stop.stopRequested())
+		throw SortCancelled(false);
+	if ((++state.checks & 63) == 0 && chrono::steady_clock::now() >= state.deadline)
+		throw SortCancelled(true);
+}
+
+/**
+ * Internal insertion sort method for the asynchronous sorts.
+ * Moves each item down with swaps instead of holding it aside, so a
+ * stays a permutation of its input if the comparator throws.
+ */
+template <typename Comparable, typename Comparator>
+void insertionSort(vector<Comparable>& a, Comparator less_than, int left, int right, SortState&)
+{
+	SORT_TRACE_SCOPE("insertion sort", right - left + 1);
+	for (int p = left + 1; p <= right; ++p)
+		for (int j = p; j > left && less_than(a[j], a[j - 1]); --j)
+			std::swap(a[j], a[j - 1]);
+}
+
+/**
+ * Internal merge method for the asynchronous sorts.
+ * The same as merge in Sort.h, but if the comparator throws, the items
+ * already moved to tmpArray are put back in the places they came from,
+ * so a stays a permutation of its input.
+ */
+template <typename Comparable, typename Comparator>
+void merge(vector<Comparable>& a, Comparator less_than, vector<Comparable>& tmpArray,
+	int leftPos, int rightPos, int rightEnd, SortState&)
+{
+	SORT_TRACE_SCOPE("merge", rightEnd - leftPos + 1);
+	const int leftStart = leftPos, rightStart = rightPos;
+	int leftEnd = rightPos - 1;
+	int tmpPos = leftPos;
+
+	try
+	{
+		while (leftPos <= leftEnd && rightPos <= rightEnd)
+			if (!less_than(a[rightPos], a[leftPos]))
+				tmpArray[tmpPos++] = std::move(a[leftPos++]);
+			else
+				tmpArray[tmpPos++] = std::move(a[rightPos++]);
+	}
+	catch (...)
+	{
+		// The moved items left a[leftStart .. leftPos - 1] and a[rightStart .. rightPos - 1]
+		int hole = leftStart;
+		for (int t = leftStart; t < tmpPos; ++t)
+		{
+			if (hole == leftPos)
+				hole = rightStart;
+			a[hole++] = std::move(tmpArray[t]);
+		}
+		throw;
+	}
+
+	while (leftPos <= leftEnd)    // Copy rest of first half
+		tmpArray[tmpPos++] = std::move(a[leftPos++]);
+
+	while (rightPos <= rightEnd)  // Copy rest of right half
+		tmpArray[tmpPos++] = std::move(a[rightPos++]);
+
+	// Copy tmpArray back
+	for (int i = leftStart; i <= rightEnd; ++i)
+		a[i] = std::move(tmpArray[i]);
+}
+
+/**
+ * Internal quicksort method for the asynchronous sorts.
+ * The same as quicksort in Sort.h, with the same cutoff, but checks for cancellation before
+ * every partition and counts the items that reach their final place. It only moves items
+ * with swaps, so a stays a permutation of its input if the comparator throws.
+ */
+template <typename Comparable, typename Comparator>
+void quicksort(vector<Comparable>& a, Comparator less_than, int left, int right, SortState& state)
+{
+	SORT_TRACE_SCOPE("quicksort", right - left + 1);
+	checkpoint(state);
+
+	if (left + sortProfile<Comparable>().insertionCutoff <= right)
+	{
+		const Comparable& pivot = median3(a, less_than, left, right);
+
+		// Begin partitioning
+		int i = left, j = right - 1;
+		for (; ; )
+		{
+			while (less_than(a[++i], pivot)) {}
+			while (less_than(pivot, a[--j])) {}
+			if (i < j)
+				std::swap(a[i], a[j]);
+			else
+				break;
+		}
+
+		std::swap(a[i], a[right - 1]);  // Restore pivot
+		state.done.fetch_add(1, memory_order_relaxed);
+
+		quicksort(a, less_than, left, i - 1, state);     // Sort small elements
+		quicksort(a, less_than, i + 1, right, state);    // Sort large elements
+	}
+	else if (left <= right)
+	{
+		insertionSort(a, less_than, left, right, state);
+		state.done.fetch_add(right - left + 1, memory_order_relaxed);
+	}
+}
+
+/**
+ * Internal mergesort method for the asynchronous sorts.
+ * Bottom-up mergesort built on the merge above. Checks for cancellation
+ * before every merge and counts the items merged in each pass.
+ * a stays a permutation of its input if the sort is cancelled or the comparator throws.
+ */
+template <typename Comparable, typename Comparator>
+void mergeSort(vector<Comparable>& a, Comparator less_than, SortState& state)
+{
+	int n = a.size();
+	vector<Comparable> tmpArray(n);
+
+	for (int width = 1; width < n; width *= 2)
+		for (int left = 0; left + width < n; left += 2 * width)
+		{
+			checkpoint(state);
+			int rightEnd = std::min(left + 2 * width, n) - 1;
+			merge(a, less_than, tmpArray, left, left + width, rightEnd, state);
+			state.done.fetch_add(rightEnd - left + 1, memory_order_relaxed);
+		}
+}
+
+/**
+ * Handle to a sort started by sortAsync.
+ */
+class SortFuture
+{
+public:
+	explicit SortFuture(shared_ptr<SortState> s) : state(std::move(s)) {}
+
+	/**
+	 * Returns true if the sort has finished, was cancelled or failed.
+	 */
+	bool ready() const
+	{
+		lock_guard<mutex> guard(state->lock);
+		return state->isFinished();
+	}
+
+	SortStatus status() const
+	{
+		lock_guard<mutex> guard(state->lock);
+		return state->status;
+	}
+
+	/**
+	 * Returns an estimate of the finished fraction of the sort, from 0 to 1.
+	 */
+	double progress() const
+	{
+		if (status() == SortStatus::Done)
+			return 1.0;
+		if (state->total == 0)
+			return 0.0;
+		return std::min(1.0, double(state->done.load(memory_order_relaxed)) / state->total);
+	}
+
+	/**
+	 * Asks the sort to stop. A sort that has not started yet will not start.
+	 */
+	void cancel()
+	{
+		state->stop.requestStop();
+	}
+
+	/**
+	 * Blocks until the sort has finished, was cancelled or failed.
+	 */
+	void wait() const
+	{
+		unique_lock<mutex> guard(state->lock);
+		state->finished.wait(guard, [&] { return state->isFinished(); });
+	}
+
+	/**
+	 * Blocks for at most timeout. Returns true if the sort is finished.
+	 */
+	template <typename Rep, typename Period>
+	bool waitFor(const chrono::duration<Rep, Period>& timeout) const
+	{
+		unique_lock<mutex> guard(state->lock);
+		return state->finished.wait_for(guard, timeout, [&] { return state->isFinished(); });
+	}
+
+	/**
+	 * Waits for the sort. Throws SortCancelled if it was cancelled or
+	 * ran past its deadline, or rethrows what the comparator threw.
+	 * The array is left a permutation of its input if the sort did not finish,
+ * whether it was cancelled, ran past its deadline or the comparator threw.
+	 */
+	void get() const
+	{
+		wait();
+		if (state->status == SortStatus::Cancelled)
+			throw SortCancelled(false);
+		if (state->status == SortStatus::DeadlineExceeded)
+			throw SortCancelled(true);
+		if (state->error)
+			rethrow_exception(state->error);
+	}
+
+#if defined(__cpp_impl_coroutine)
+	bool await_ready() const { return ready(); }
+
+	bool await_suspend(coroutine_handle<> waiting)
+	{
+		lock_guard<mutex> guard(state->lock);
+		if (state->isFinished())
+			return false;
+		state->continuation = [waiting] { waiting.resume(); };
+		return true;
+	}
+
+	void await_resume() const { get(); }
+#endif
+
+private:
+	shared_ptr<SortState> state;
+};
+
+/**
+ * A fixed set of worker threads that run queued sorts.
+ */
+class SortThreadPool
+{
+public:
+	explicit SortThreadPool(int numThreads)
+	{
+		for (int t = 0; t < numThreads; ++t)
+			workers.emplace_back([this] { work(); });
+	}
+
+	/**
+	 * Runs the sorts still queued, then stops the workers.
+	 */
+	~SortThreadPool()
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+		}
+		wakeup.notify_all();
+		for (auto& w : workers)
+			w.join();
+	}
+
+	SortThreadPool(const SortThreadPool&) = delete;
+	SortThreadPool& operator=(const SortThreadPool&) = delete;
+
+	int size() const { return workers.size(); }
+
+	/**
+	 * Queues task. Small tasks may be run in a batch with other small tasks.
+	 */
+	void submit(function<void()> task, bool small)
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			tasks.push_back(Task{ std::move(task), small });
+		}
+		wakeup.notify_one();
+	}
+
+private:
+	struct Task
+	{
+		function<void()> run;
+		bool small;
+	};
+
+	void work()
+	{
+		vector<Task> batch;
+		for (; ; )
+		{
+			{
+				unique_lock<mutex> guard(lock);
+				wakeup.wait(guard, [this] { return stopping || !tasks.empty(); });
+				if (tasks.empty())
+					return;
+
+				// Take one large task, or a run of up to ASYNC_BATCH_SIZE small ones
+				do
+				{
+					batch.push_back(std::move(tasks.front()));
+					tasks.pop_front();
+				} while (batch.back().small && int(batch.size()) < ASYNC_BATCH_SIZE &&
+					!tasks.empty() && tasks.front().small);
+			}
+
+			for (auto& task : batch)
+				task.run();
+			batch.clear();
+		}
+	}
+
+	mutex lock;
+	condition_variable wakeup;
+	deque<Task> tasks;
+	bool stopping = false;
+	vector<thread> workers;
+};
+
+/**
+ * Returns the pool shared by all sortAsync calls, with one thread per core.
+ */
+inline SortThreadPool& sharedSortThreadPool()
+{
+	static SortThreadPool pool(std::max(1u, thread::hardware_concurrency()));
+	return pool;
+}
+
+/**
+ * Asynchronous sort.
+ * Queues the sort of a on pool and returns a handle to it right away.
+ * a must stay alive, and must not be used, until the sort is finished.
+ */
+template <typename Comparable, typename Comparator>
+SortFuture sortAsync(vector<Comparable>& a, Comparator less_than, const SortPolicy& policy = SortPolicy(),
+	SortThreadPool& pool = sharedSortThreadPool())
+{
+	auto state = make_shared<SortState>();
+	state->stop = policy.stop;
+	state->deadline = policy.deadline;
+	state->total = a.size();
+	if (policy.algorithm == SortAlgorithm::MergeSort && a.size() > 1)
+	{
+		// Every pass of the bottom-up mergesort touches every item once
+		int passes = 0;
+		for (size_t width = 1; width < a.size(); width *= 2)
+			++passes;
+		state->total *= passes;
+	}
+
+	SortAlgorithm algorithm = policy.algorithm;
+	pool.submit([state, &a, less_than, algorithm]
+	{
+		SortStatus result = SortStatus::Done;
+		{
+			lock_guard<mutex> guard(state->lock);
+			state->status = SortStatus::Running;
+		}
+
+		try
+		{
+			SORT_TRACE_SCOPE("async sort", a.size());
+			checkpoint(*state);
+			if (chrono::steady_clock::now() >= state->deadline)
+				throw SortCancelled(true);
+
+			if (algorithm == SortAlgorithm::MergeSort)
+				mergeSort(a, less_than, *state);
+			else
+				quicksort(a, less_than, 0, int(a.size()) - 1, *state);
+		}
+		catch (const SortCancelled& cancelled)
+		{
+			result = cancelled.deadlineExceeded ? SortStatus::DeadlineExceeded : SortStatus::Cancelled;
+		}
+		catch (...)
+		{
+			state->error = current_exception();
+			result = SortStatus::Failed;
+		}
+
+		function<void()> continuation;
+		{
+			lock_guard<mutex> guard(state->lock);
+			state->status = result;
+			continuation.swap(state->continuation);
+		}
+		state->finished.notify_all();
+		if (continuation)
+			continuation();
+	}, a.size() < size_t(ASYNC_SMALL_SORT));
+
+	return SortFuture(state);
+}
+
+#endif
@@ -0,0 +1,540 @@
+/*
+	This is the DistributedSort.h header file.
+	This file contains the distributed sort, which sorts data spread across
+	several worker processes (possibly on several machines), and the
+	transports the workers use to talk to each other.
+
+	The sort runs in three phases:
+	  1. Sample: every worker sends its item count and a random sample of
+	     its items to every other worker, so all of them pick the same
+	     global splitters.
+	  2. Exchange: every worker splits its items by the splitters and sends
+	     partition k to worker k. Each partition that arrives is sorted with
+	     quicksort right away, while the rest are still being sent.
+	     When the sample repeats a splitter, the input holds many copies of
+	     it; those are dealt round-robin to every worker whose range can
+	     hold them, in proportion to their share of the sample, instead of
+	     all going to one.
+	  3. Merge: the sorted partitions are merged with merge from Sort.h.
+	Afterwards worker k holds the k-th slice of the global sorted order.
+
+	Transport is the interface between workers. SocketTransport implements
+	it over connected stream sockets, set up either over TCP (connectTcpMesh)
+	or over Unix domain sockets (connectUnixMesh), so several processes on
+	one machine can stand in for a cluster.
+*/
+
+#ifndef DISTRIBUTED_SORT_H
+#define DISTRIBUTED_SORT_H
+
+#include "Sort.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * Number of sample items each worker takes per worker.
+ */
+const int DISTRIBUTED_OVERSAMPLING = 64;
+
+/**
+ * Point-to-point byte transport between the workers of a distributed sort.
+ * Workers are numbered 0 .. size() - 1.
+ * send and receive block until all bytes are transferred, and may be called
+ * at the same time from two different threads.
+ */
+class Transport
+{
+public:
+	virtual ~Transport() {}
+
+	virtual int rank() const = 0;
+	virtual int size() const = 0;
+	virtual void send(int peer, const void* data, size_t bytes) = 0;
+	virtual void receive(int peer, void* data, size_t bytes) = 0;
+};
+
+/**
+ * Transport over one connected stream socket per peer.
+ */
+class SocketTransport : public Transport
+{
+public:
+	/**
+	 * sockets[peer] is the connected socket to peer; sockets[rank] is unused.
+	 * Takes ownership of the sockets.
+	 */
+	SocketTransport(int rank, const vector<int>& sockets)
+		: myRank(rank), peers(sockets)
+	{
+	}
+
+	~SocketTransport()
+	{
+		for (int p = 0; p < int(peers.size()); ++p)
+			if (p != myRank && peers[p] >= 0)
+				close(peers[p]);
+	}
+
+	SocketTransport(const SocketTransport&) = delete;
+	SocketTransport& operator=(const SocketTransport&) = delete;
+
+	int rank() const override { return myRank; }
+	int size() const override { return peers.size(); }
+
+	void send(int peer, const void* data, size_t bytes) override
+	{
+		const char* p = static_cast<const char*>(data);
+		while (bytes > 0)
+		{
+			ssize_t sent = ::send(peers[peer], p, bytes, MSG_NOSIGNAL);
+			if (sent < 0 && errno == EINTR)
+				continue;
+			if (sent <= 0)
+				throw runtime_error("send to worker " + to_string(peer) + " failed: " + strerror(errno));
+			p += sent;
+			bytes -= sent;
+		}
+	}
+
+	void receive(int peer, void* data, size_t bytes) override
+	{
+		char* p = static_cast<char*>(data);
+		while (bytes > 0)
+		{
+			ssize_t received = ::recv(peers[peer], p, bytes, 0);
+			if (received < 0 && errno == EINTR)
+				continue;
+			if (received <= 0)
+				throw runtime_error("receive from worker " + to_string(peer) + " failed: " +
+					(received == 0 ? string("connection closed") : string(strerror(errno))));
+			p += received;
+			bytes -= received;
+		}
+	}
+
+private:
+	int myRank;
+	vector<int> peers;
+};
+
+/**
+ * Owns a socket and closes it when it goes out of scope, so a connection
+ * set up half way is not leaked when a later step throws.
+ * release() hands the socket on without closing it.
+ */
+class SocketHandle
+{
+public:
+	explicit SocketHandle(int fd = -1) : fd(fd) {}
+
+	~SocketHandle()
+	{
+		reset();
+	}
+
+	SocketHandle(SocketHandle&& other) noexcept : fd(other.release()) {}
+
+	SocketHandle& operator=(SocketHandle&& other) noexcept
+	{
+		reset(other.release());
+		return *this;
+	}
+
+	SocketHandle(const SocketHandle&) = delete;
+	SocketHandle& operator=(const SocketHandle&) = delete;
+
+	int get() const { return fd; }
+
+	int release()
+	{
+		int s = fd;
+		fd = -1;
+		return s;
+	}
+
+	void reset(int s = -1)
+	{
+		if (fd >= 0)
+			close(fd);
+		fd = s;
+	}
+
+private:
+	int fd;
+};
+
+/**
+ * Internal method for the socket meshes.
+ * Given a listening socket, connects this worker to every other worker:
+ * it connects to every lower rank with connectTo(peer) and accepts a
+ * connection from every higher rank. Each connecting side first sends
+ * its rank so the accepting side knows who is on the other end.
+ * The listener and every socket opened so far are closed if a step fails.
+ */
+template <typename Connector>
+unique_ptr<Transport> connectMesh(SocketHandle listener, int rank, int size, Connector connectTo)
+{
+	vector<SocketHandle> sockets(size);
+
+	for (int peer = 0; peer < rank; ++peer)
+	{
+		sockets[peer] = SocketHandle(connectTo(peer));
+		int32_t me = rank;
+		if (::send(sockets[peer].get(), &me, sizeof(me), MSG_NOSIGNAL) != sizeof(me))
+			throw runtime_error("handshake with worker " + to_string(peer) + " failed");
+	}
+
+	for (int accepted = rank + 1; accepted < size; ++accepted)
+	{
+		SocketHandle s(accept(listener.get(), nullptr, nullptr));
+		if (s.get() < 0)
+			throw runtime_error(string("accept failed: ") + strerror(errno));
+		int32_t peer = -1;
+		if (recv(s.get(), &peer, sizeof(peer), MSG_WAITALL) != sizeof(peer) || peer <= rank || peer >= size)
+			throw runtime_error("bad handshake from a worker");
+		sockets[peer] = std::move(s);
+	}
+
+	listener.reset();
+
+	// The transport owns the sockets from here on
+	vector<int> fds(size, -1);
+	for (int p = 0; p < size; ++p)
+		fds[p] = sockets[p].get();
+	unique_ptr<Transport> transport(new SocketTransport(rank, fds));
+	for (SocketHandle& s : sockets)
+		s.release();
+	return transport;
+}
+
+/**
+ * Internal method for the socket meshes.
+ * Calls tryConnect() until it returns a connected socket, so a worker can
+ * start before the worker it connects to is listening. Gives up after 30 seconds.
+ */
+template <typename TryConnect>
+int connectWithRetry(int peer, TryConnect tryConnect)
+{
+	for (int attempt = 0; attempt < 3000; ++attempt)
+	{
+		int s = tryConnect();
+		if (s >= 0)
+			return s;
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	throw runtime_error("could not connect to worker " + to_string(peer));
+}
+
+/**
+ * Connects worker rank of size workers over Unix domain sockets.
+ * Worker k listens on directory/worker<k>.sock; all workers must use the same directory.
+ */
+inline unique_ptr<Transport> connectUnixMesh(const string& directory, int rank, int size)
+{
+	auto address = [&](int worker)
+	{
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		string path = directory + "/worker" + to_string(worker) + ".sock";
+		if (path.size() >= sizeof(addr.sun_path))
+			throw runtime_error("socket path too long: " + path);
+		strcpy(addr.sun_path, path.c_str());
+		return addr;
+	};
+
+	SocketHandle listener(socket(AF_UNIX, SOCK_STREAM, 0));
+	sockaddr_un self = address(rank);
+	unlink(self.sun_path);
+	if (listener.get() < 0 || bind(listener.get(), (sockaddr*)&self, sizeof(self)) < 0 || listen(listener.get(), size) < 0)
+		throw runtime_error(string("cannot listen on ") + self.sun_path + ": " + strerror(errno));
+
+	return connectMesh(std::move(listener), rank, size, [&](int peer)
+	{
+		sockaddr_un addr = address(peer);
+		return connectWithRetry(peer, [&]()
+		{
+			int s = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (s >= 0 && connect(s, (sockaddr*)&addr, sizeof(addr)) == 0)
+				return s;
+			if (s >= 0)
+				close(s);
+			return -1;
+		});
+	});
+}
+
+/**
+ * Connects worker rank over TCP.
+ * hosts[k] is the host name of worker k, which listens on port basePort + k.
+ */
+inline unique_ptr<Transport> connectTcpMesh(const vector<string>& hosts, int basePort, int rank)
+{
+	int size = hosts.size();
+	int one = 1;
+
+	SocketHandle listener(socket(AF_INET, SOCK_STREAM, 0));
+	sockaddr_in self;
+	memset(&self, 0, sizeof(self));
+	self.sin_family = AF_INET;
+	self.sin_addr.s_addr = htonl(INADDR_ANY);
+	self.sin_port = htons(basePort + rank);
+	if (listener.get() < 0 || setsockopt(listener.get(), SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+		bind(listener.get(), (sockaddr*)&self, sizeof(self)) < 0 || listen(listener.get(), size) < 0)
+		throw runtime_error("cannot listen on port " + to_string(basePort + rank) + ": " + strerror(errno));
+
+	unique_ptr<Transport> transport = connectMesh(std::move(listener), rank, size, [&](int peer)
+	{
+		return connectWithRetry(peer, [&]()
+		{
+			addrinfo hints, *found = nullptr;
+			memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_STREAM;
+			if (getaddrinfo(hosts[peer].c_str(), to_string(basePort + peer).c_str(), &hints, &found) != 0)
+				return -1;
+
+			int s = socket(AF_INET, SOCK_STREAM, 0);
+			if (s >= 0 && connect(s, found->ai_addr, found->ai_addrlen) != 0)
+			{
+				close(s);
+				s = -1;
+			}
+			freeaddrinfo(found);
+			if (s >= 0)
+				setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			return s;
+		});
+	});
+	return transport;
+}
+
+/**
+ * Time and traffic of each phase of one worker's distributed sort.
+ * The local sorting of received partitions overlaps the exchange phase,
+ * so exchangeSeconds includes sortSeconds.
+ */
+struct DistributedSortStats
+{
+	double sampleSeconds = 0;
+	double exchangeSeconds = 0;
+	double sortSeconds = 0;
+	double mergeSeconds = 0;
+	size_t sampleBytesSent = 0;
+	size_t sampleBytesReceived = 0;
+	size_t exchangeBytesSent = 0;
+	size_t exchangeBytesReceived = 0;
+};
+
+/**
+ * Internal method for the distributed sort.
+ * Sends outgoing[k] to every worker k and calls received(k, items) with the
+ * items from every worker k, starting with this worker's own outgoing[rank].
+ * Worker k may send at most maxCount[k] items; a larger count (a truncated
+ * or corrupt stream) throws runtime_error before anything is allocated.
+ * Sending runs on its own thread, so received() overlaps the sends.
+ * Step s sends to rank + s and receives from rank - s, so no worker waits on
+ * a peer that is itself waiting on a later step.
+ * Adds the bytes sent and received to bytesSent and bytesReceived.
+ */
+template <typename Comparable, typename Receiver>
+void exchangeAll(Transport& transport, vector<vector<Comparable>>& outgoing, const vector<uint64_t>& maxCount,
+	Receiver received, size_t& bytesSent, size_t& bytesReceived)
+{
+	int rank = transport.rank(), size = transport.size();
+
+	exception_ptr sendError;
+	thread sender([&]()
+	{
+		try
+		{
+			for (int step = 1; step < size; ++step)
+			{
+				int peer = (rank + step) % size;
+				uint64_t count = outgoing[peer].size();
+				transport.send(peer, &count, sizeof(count));
+				transport.send(peer, outgoing[peer].data(), count * sizeof(Comparable));
+				bytesSent += sizeof(count) + count * sizeof(Comparable);
+			}
+		}
+		catch (...)
+		{
+			sendError = current_exception();
+		}
+	});
+
+	try
+	{
+		received(rank, outgoing[rank]);
+
+		for (int step = 1; step < size; ++step)
+		{
+			int peer = (rank - step + size) % size;
+			uint64_t count;
+			transport.receive(peer, &count, sizeof(count));
+			if (count > maxCount[peer])
+				throw runtime_error("worker " + to_string(peer) + " sent a count of " + to_string(count) +
+					" items, more than the " + to_string(maxCount[peer]) + " it can hold");
+			vector<Comparable> items(count);
+			transport.receive(peer, items.data(), count * sizeof(Comparable));
+			bytesReceived += sizeof(count) + count * sizeof(Comparable);
+			received(peer, items);
+		}
+	}
+	catch (...)
+	{
+		sender.join();
+		throw;
+	}
+	sender.join();
+	if (sendError)
+		rethrow_exception(sendError);
+}
+
+/**
+ * Distributed sort.
+ * a holds this worker's items on entry, and this worker's slice of the
+ * global sorted order on return: every item on worker k is ordered before
+ * every item on worker k + 1.
+ * Comparable must be trivially copyable, since items are sent as raw bytes.
+ * Every worker must call this with the same less_than.
+ * Returns the time and traffic of each phase.
+ */
+template <typename Comparable, typename Comparator>
+DistributedSortStats distributedSort(vector<Comparable>& a, Comparator less_than, Transport& transport)
+{
+	static_assert(is_trivially_copyable<Comparable>::value, "distributedSort sends items as raw bytes");
+
+	typedef chrono::steady_clock Time;
+	DistributedSortStats stats;
+	int rank = transport.rank(), size = transport.size();
+
+	// Phase 1: every worker learns every item count and every sample, and picks the same splitters
+	auto begin = Time::now();
+	const uint64_t maxItems = vector<Comparable>().max_size();
+	vector<vector<uint64_t>> counts(size, vector<uint64_t>(1, a.size()));
+	vector<uint64_t> peerItems(size);
+	exchangeAll(transport, counts, vector<uint64_t>(size, 1), [&](int peer, vector<uint64_t>& count)
+	{
+		if (count.size() != 1 || count[0] > maxItems)
+			throw runtime_error("worker " + to_string(peer) + " announced a bad item count");
+		peerItems[peer] = count[0];
+	}, stats.sampleBytesSent, stats.sampleBytesReceived);
+
+	vector<vector<Comparable>> outgoing(size);
+	minstd_rand random(rank + 1);
+	for (int i = 0; i < size * DISTRIBUTED_OVERSAMPLING && !a.empty(); ++i)
+		outgoing[0].push_back(a[random() % a.size()]);
+	for (int peer = 1; peer < size; ++peer)
+		outgoing[peer] = outgoing[0];
+
+	vector<Comparable> sample;
+	exchangeAll(transport, outgoing, vector<uint64_t>(size, size * DISTRIBUTED_OVERSAMPLING), [&](int, vector<Comparable>& items)
+	{
+		sample.insert(sample.end(), items.begin(), items.end());
+	}, stats.sampleBytesSent, stats.sampleBytesReceived);
+	quicksort(sample, less_than);
+
+	vector<Comparable> splitters;
+	for (int k = 1; k < size && !sample.empty(); ++k)
+		splitters.push_back(sample[(long long)k * sample.size() / size]);
+
+	// A splitter the sample holds more than once has many copies in the input. If splitters
+	// k .. end are equal, worker k holds the items up to them and workers k + 1 .. end + 1
+	// the items after them, so any of these workers may hold the copies. The copies are dealt
+	// to them in proportion to the copies in each one's share of the sorted sample.
+	int numSplitters = splitters.size();
+	vector<vector<int>> dealTable(numSplitters);
+	vector<size_t> dealt(numSplitters, rank);
+	for (int k = 0, end; k < numSplitters; k = end + 1)
+	{
+		end = k;
+		while (end + 1 < numSplitters && !less_than(splitters[k], splitters[end + 1]))
+			++end;
+		long long first = lower_bound(sample.begin(), sample.end(), splitters[k], less_than) - sample.begin();
+		long long last = upper_bound(sample.begin(), sample.end(), splitters[k], less_than) - sample.begin();
+		if (last - first > 1)
+			for (long long p = first; p < last; ++p)
+				dealTable[k].push_back(std::clamp(int(p * size / (long long)sample.size()), k, end + 1));
+	}
+	stats.sampleSeconds = chrono::duration<double>(Time::now() - begin).count();
+
+	// Phase 2: split by the splitters, exchange, and sort each partition as it arrives
+	begin = Time::now();
+	for (auto& partition : outgoing)
+		partition.clear();
+	for (auto& x : a)
+	{
+		// Binary search for the first splitter that is not less than x
+		int lo = 0, hi = splitters.size();
+		while (lo < hi)
+		{
+			int mid = (lo + hi) / 2;
+			if (less_than(splitters[mid], x))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		// Deal the copies of a heavy splitter round-robin, starting at a different place on each worker
+		if (lo < numSplitters && !dealTable[lo].empty() && !less_than(x, splitters[lo]))
+			outgoing[dealTable[lo][dealt[lo]++ % dealTable[lo].size()]].push_back(x);
+		else
+			outgoing[lo].push_back(x);
+	}
+	vector<Comparable>().swap(a);
+
+	vector<int> runStart(1, 0);
+	exchangeAll(transport, outgoing, peerItems, [&](int, vector<Comparable>& items)
+	{
+		auto sortBegin = Time::now();
+		quicksort(items, less_than);
+		a.insert(a.end(), items.begin(), items.end());
+		runStart.push_back(a.size());
+		stats.sortSeconds += chrono::duration<double>(Time::now() - sortBegin).count();
+	}, stats.exchangeBytesSent, stats.exchangeBytesReceived);
+	stats.exchangeSeconds = chrono::duration<double>(Time::now() - begin).count();
+
+	// Phase 3: merge the sorted partitions pairwise until one run is left
+	begin = Time::now();
+	vector<Comparable> tmpArray(a.size());
+	while (runStart.size() > 2)
+	{
+		vector<int> merged(1, 0);
+		for (int r = 0; r + 1 < int(runStart.size()); r += 2)
+		{
+			if (r + 2 < int(runStart.size()))
+			{
+				if (runStart[r] < runStart[r + 1] && runStart[r + 1] < runStart[r + 2])
+					merge(a, less_than, tmpArray, runStart[r], runStart[r + 1], runStart[r + 2] - 1);
+				merged.push_back(runStart[r + 2]);
+			}
+			else
+				merged.push_back(runStart[r + 1]);
+		}
+		runStart = merged;
+	}
+	stats.mergeSeconds = chrono::duration<double>(Time::now() - begin).count();
+
+	return stats;
+}
+
+#endif
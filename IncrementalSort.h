@@ -0,0 +1,251 @@
+/*
+	This is the IncrementalSort.h header file.
+	This file contains LazySortedView, which reads a vector in sorted order
+	while sorting only as much of it as has been read (incremental
+	quicksort).
+
+	A paginated query that shows the first k items of an n item result
+	pays O(n + k log k) expected time instead of the O(n log n) of sorting
+	it all, and reading every item still costs O(n log n) in total.
+
+	The view partitions the vector in place with the median-of-three
+	partitioning of quicksort in Sort.h. It keeps a stack of the ranges of
+	ranks that are already in their final places (at first the pivots),
+	lowest on top. Everything between two of them is unsorted, but lies
+	between them in the order. Getting the next rank only partitions the
+	unsorted range just above the top of the stack, pushing a pivot each
+	time, until the rank is a pivot or the range is small enough to sort.
+	A range of ranks anywhere in the vector is found the same way, starting
+	from the unsorted range that holds it.
+
+	The vector is reordered while the view is read, so it must not be
+	changed or resized while the view is in use. An item, once returned,
+	stays where it is.
+*/
+
+#ifndef INCREMENTAL_SORT_H
+#define INCREMENTAL_SORT_H
+
+#include "Sort.h"
+#include <cassert>
+#include <vector>
+using namespace std;
+
+/**
+ * Sorted view of a vector that sorts it as it is read.
+ */
+template <typename Comparable, typename Comparator>
+class LazySortedView
+{
+public:
+	/**
+	 * a is the vector to read in the order of less_than.
+	 */
+	explicit LazySortedView(vector<Comparable>& a, Comparator less_than = Comparator())
+		: a(a), less_than(less_than), cursor(0)
+	{
+	}
+
+	int size() const { return a.size(); }
+
+	/**
+	 * Returns true if next() has items left.
+	 */
+	bool hasNext() const { return cursor < int(a.size()); }
+
+	/**
+	 * Returns the item after the one the previous call returned
+	 * (the smallest one on the first call). hasNext() must be true.
+	 */
+	const Comparable& next()
+	{
+		return at(cursor++);
+	}
+
+	/**
+	 * Returns the rank of the item the next call to next() returns.
+	 */
+	int position() const { return cursor; }
+
+	/**
+	 * Makes next() continue from rank k.
+	 * k is clamped to 0 .. size(); seeking to size() or beyond ends the reading.
+	 */
+	void seek(int k)
+	{
+		cursor = k < 0 ? 0 : k > int(a.size()) ? int(a.size()) : k;
+	}
+
+	/**
+	 * Returns the item of rank k (0 for the smallest).
+	 * k must be in 0 .. size() - 1.
+	 */
+	const Comparable& at(int k)
+	{
+		assert(0 <= k && k < int(a.size()));
+		sortRange(k, k + 1);
+		return a[k];
+	}
+
+	/**
+	 * Puts the items of ranks first .. last - 1 in their places,
+	 * so a[first] .. a[last - 1] can be read in sorted order.
+	 */
+	void sortRange(int first, int last)
+	{
+		if (first < 0)
+			first = 0;
+		if (last > int(a.size()))
+			last = a.size();
+
+		while (first < last)
+		{
+			// Skip the ranks already in place, then sort the unsorted range that holds first
+			int s = stackBelow(first);
+			if (s >= 0 && first < sorted[s].last)
+			{
+				first = sorted[s].last;
+				continue;
+			}
+			int above = (s >= 0 ? s : int(sorted.size())) - 1;
+			int lo = s >= 0 ? sorted[s].last : 0;
+			int hi = above >= 0 ? sorted[above].first : a.size();
+			refine(lo, hi, first, last);
+			first = hi;
+		}
+	}
+
+	/**
+	 * Returns the number of ranges of ranks in place on the stack (for testing).
+	 */
+	int stackSize() const { return sorted.size(); }
+
+private:
+	/**
+	 * Ranks first .. last - 1 are in their final places.
+	 */
+	struct SortedRange
+	{
+		int first;
+		int last;
+	};
+
+	/**
+	 * Internal method that returns the index in sorted of the highest range
+	 * starting at or below rank k, or -1 if there is none.
+	 * The stack is kept highest first, so this is a binary search.
+	 */
+	int stackBelow(int k) const
+	{
+		// sorted is in decreasing order of first; find the first entry with first <= k
+		int lo = 0, hi = sorted.size();
+		while (lo < hi)
+		{
+			int mid = (lo + hi) / 2;
+			if (sorted[mid].first <= k)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo < int(sorted.size()) ? lo : -1;
+	}
+
+	/**
+	 * Internal method that records ranks first .. last - 1 as in place,
+	 * joining the range with its neighbours on the stack when they touch.
+	 */
+	void markSorted(int first, int last)
+	{
+		// The range goes at index at: sorted[at] is the range just below it, sorted[at - 1] the one just above
+		int s = stackBelow(first);
+		int at = s >= 0 ? s : sorted.size();
+
+		if (at < int(sorted.size()) && sorted[at].last == first)
+		{
+			sorted[at].last = last;
+			if (at > 0 && sorted[at - 1].first == last)
+			{
+				sorted[at].last = sorted[at - 1].last;
+				sorted.erase(sorted.begin() + at - 1);
+			}
+			return;
+		}
+		if (at > 0 && sorted[at - 1].first == last)
+		{
+			sorted[at - 1].first = first;
+			return;
+		}
+		sorted.insert(sorted.begin() + at, SortedRange{ first, last });
+	}
+
+	/**
+	 * Internal method that partitions the unsorted ranks lo .. hi - 1 until
+	 * the ranks first .. last - 1 among them are in place.
+	 * The parts not needed are left unsorted between the pivots.
+	 */
+	void refine(int lo, int hi, int first, int last)
+	{
+		int cutoff = sortProfile<Comparable>().insertionCutoff;
+		if (cutoff < 3)
+			cutoff = 3;
+
+		while (lo < hi)
+		{
+			// Small ranges, and ranges wanted whole, are sorted outright
+			if (hi - lo <= cutoff || (first <= lo && hi <= last))
+			{
+				quicksort(a, less_than, lo, hi - 1);
+				markSorted(lo, hi);
+				return;
+			}
+
+			int p = partition(lo, hi - 1);
+			markSorted(p, p + 1);
+
+			bool leftWanted = first < p && lo < last;
+			bool rightWanted = p + 1 < last && first < hi;
+			if (leftWanted && rightWanted)
+			{
+				refine(lo, p, first, last);
+				lo = p + 1;
+			}
+			else if (leftWanted)
+				hi = p;
+			else if (rightWanted)
+				lo = p + 1;
+			else
+				return;
+		}
+	}
+
+	/**
+	 * Internal method that partitions a[left..right] around its median of
+	 * three, as quicksort does, and returns where the pivot ends up.
+	 */
+	int partition(int left, int right)
+	{
+		SORT_TRACE_SCOPE("partition", right - left + 1);
+		const Comparable& pivot = median3(a, less_than, left, right);
+
+		int i = left, j = right - 1;
+		for (; ; )
+		{
+			while (less_than(a[++i], pivot)) {}
+			while (less_than(pivot, a[--j])) {}
+			if (i < j)
+				std::swap(a[i], a[j]);
+			else
+				break;
+		}
+
+		std::swap(a[i], a[right - 1]);  // Restore pivot
+		return i;
+	}
+
+	vector<Comparable>& a;
+	Comparator less_than;
+	int cursor;
+	vector<SortedRange> sorted;	// The stack of ranks in place, highest first
+};
+
+#endif
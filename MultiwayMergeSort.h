@@ -0,0 +1,241 @@
+/*
+	This is the MultiwayMergeSort.h header file.
+	This file contains multiwayMergeSort, a stable mergesort that makes far
+	fewer passes over main memory than mergeSort in Sort.h.
+
+	mergeSort merges two runs at a time, so it reads and writes the whole
+	array about log2(n) times. multiwayMergeSort first sorts blocks that fit
+	in the L2 cache (with mergeSort, so each block is sorted without going
+	back to memory), then merges up to MULTIWAY_MAX_FAN_IN runs at a time
+	with a tournament (loser) tree. The fan-in is chosen so every merge pass
+	uses about the same number of runs; a billion ints take one block pass
+	and two or three merge passes.
+
+	On x86-64, 4 and 8 byte trivially copyable items are written with
+	non-temporal (streaming) stores during the merge passes, so the output
+	does not evict the runs being read from the cache.
+*/
+
+#ifndef MULTIWAY_MERGE_SORT_H
+#define MULTIWAY_MERGE_SORT_H
+
+#include "Sort.h"
+#include <cstring>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+#if defined(__SSE2__) && defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+/**
+ * Cache size assumed when the L2 and last-level cache sizes cannot be detected.
+ */
+const long MULTIWAY_DEFAULT_CACHE = 256 * 1024;
+
+/**
+ * Fewest and most runs merged at once.
+ */
+const int MULTIWAY_MIN_FAN_IN = 8;
+const int MULTIWAY_MAX_FAN_IN = 64;
+
+/**
+ * What a multiwayMergeSort did, for the benchmark.
+ */
+struct MultiwayMergeStats
+{
+	int blockSize = 0;			// Items in each cache-sized block
+	int runs = 0;				// Sorted blocks before merging
+	int fanIn = 0;				// Runs merged at once
+	int passes = 0;				// Passes over memory, counting the block sort pass
+	long long bytesMoved = 0;	// Bytes read and written in those passes
+};
+
+/**
+ * Returns the size in bytes of the L2 cache, or of the last-level cache
+ * if the L2 size is unknown.
+ */
+inline long detectCacheSize()
+{
+	long size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	if (size <= 0)
+		size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+	return size > 0 ? size : MULTIWAY_DEFAULT_CACHE;
+}
+
+/**
+ * Internal method for the merge passes that moves x to dst,
+ * bypassing the cache where the item type allows it.
+ */
+template <typename Comparable>
+inline void streamStore(Comparable* dst, Comparable& x)
+{
+#if defined(__SSE2__) && defined(__x86_64__)
+	if constexpr (is_trivially_copyable<Comparable>::value && sizeof(Comparable) == 8)
+	{
+		long long bits;
+		memcpy(&bits, &x, 8);
+		_mm_stream_si64(reinterpret_cast<long long*>(dst), bits);
+		return;
+	}
+	else if constexpr (is_trivially_copyable<Comparable>::value && sizeof(Comparable) == 4)
+	{
+		int bits;
+		memcpy(&bits, &x, 4);
+		_mm_stream_si32(reinterpret_cast<int*>(dst), bits);
+		return;
+	}
+#endif
+	*dst = std::move(x);
+}
+
+/**
+ * Internal method that makes the streaming stores of a merge pass visible.
+ */
+inline void streamFence()
+{
+#if defined(__SSE2__) && defined(__x86_64__)
+	_mm_sfence();
+#endif
+}
+
+/**
+ * Internal method that merges the sorted runs of src starting at the
+ * positions in bounds[first..last) (each run ends where the next starts)
+ * into dst at the same positions, with a loser tree.
+ * Of equal items, those from earlier runs come first, so the merge is stable.
+ */
+template <typename Comparable, typename Comparator>
+void mergeRuns(vector<Comparable>& src, vector<Comparable>& dst, Comparator less_than,
+	const vector<int>& bounds, int first, int last)
+{
+	int k = last - first;
+	int leaves = 1;
+	while (leaves < k)
+		leaves *= 2;
+
+	// The next item and the end of each run; the padding runs are empty
+	vector<Comparable*> head(leaves, src.data()), tail(leaves, src.data());
+	for (int r = 0; r < k; ++r)
+	{
+		head[r] = src.data() + bounds[first + r];
+		tail[r] = src.data() + bounds[first + r + 1];
+	}
+
+	// Returns true if the head of run x goes before the head of run y; empty runs go last.
+	// On a tie the earlier run wins, so one comparison decides either way
+	auto beats = [&](int x, int y)
+	{
+		if (head[x] == tail[x])
+			return false;
+		if (head[y] == tail[y])
+			return true;
+		return x < y ? !less_than(*head[y], *head[x]) : less_than(*head[x], *head[y]);
+	};
+
+	// tree[node] holds the loser of the match at node; tree[0] the overall winner
+	vector<int> tree(leaves);
+	vector<int> winner(2 * leaves);
+	for (int r = 0; r < leaves; ++r)
+		winner[leaves + r] = r;
+	for (int node = leaves - 1; node >= 1; --node)
+	{
+		int x = winner[2 * node], y = winner[2 * node + 1];
+		if (!beats(x, y))
+			std::swap(x, y);
+		winner[node] = x;
+		tree[node] = y;
+	}
+	tree[0] = winner[1];
+
+	int out = bounds[first];
+	for (int remaining = bounds[last] - bounds[first]; remaining > 0; --remaining)
+	{
+		int w = tree[0];
+		streamStore(&dst[out++], *head[w]++);
+
+		// Replay the matches from w's leaf to the root
+		for (int node = (leaves + w) / 2; node >= 1; node /= 2)
+			if (beats(tree[node], w))
+				std::swap(tree[node], w);
+		tree[0] = w;
+	}
+}
+
+/**
+ * Multiway mergesort algorithm.
+ * Sorts blocks of about half the detected cache size with mergeSort,
+ * then merges them fanIn runs at a time. Stable.
+ * Returns what it did, for reporting.
+ */
+template <typename Comparable, typename Comparator>
+MultiwayMergeStats multiwayMergeSort(vector<Comparable>& a, Comparator less_than)
+{
+	MultiwayMergeStats stats;
+	int n = a.size();
+	long long bytesPerPass = 2LL * n * sizeof(Comparable);
+
+	// A block and its part of the merge buffer fit in the cache together
+	long blockSize = detectCacheSize() / (2 * long(sizeof(Comparable)));
+	stats.blockSize = int(blockSize < 16 ? 16 : blockSize > n ? (n > 0 ? n : 1) : blockSize);
+
+	vector<Comparable> tmp(n);
+	vector<int> bounds;
+	for (int left = 0; left < n; left += stats.blockSize)
+	{
+		int right = n - left > stats.blockSize ? left + stats.blockSize - 1 : n - 1;
+		mergeSort(a, less_than, tmp, left, right);
+		bounds.push_back(left);
+	}
+	bounds.push_back(n);
+	stats.runs = bounds.size() - 1;
+	stats.passes = 1;
+	stats.bytesMoved = bytesPerPass;
+	if (stats.runs <= 1)
+		return stats;
+
+	// Use the fewest passes MULTIWAY_MAX_FAN_IN allows, with the same fan-in in each
+	int passes = 1;
+	for (long long reach = MULTIWAY_MAX_FAN_IN; reach < stats.runs; reach *= MULTIWAY_MAX_FAN_IN)
+		++passes;
+	int fanIn = MULTIWAY_MIN_FAN_IN;
+	for (;;)
+	{
+		long long reach = 1;
+		for (int p = 0; p < passes && reach < stats.runs; ++p)
+			reach *= fanIn;
+		if (reach >= stats.runs || fanIn == MULTIWAY_MAX_FAN_IN)
+			break;
+		++fanIn;
+	}
+	stats.fanIn = fanIn < stats.runs ? fanIn : stats.runs;
+
+	while (bounds.size() > 2)
+	{
+		SORT_TRACE_SCOPE("merge pass", n);
+		vector<int> merged;
+		int runs = bounds.size() - 1;
+		for (int first = 0; first < runs; first += fanIn)
+		{
+			int last = first + fanIn < runs ? first + fanIn : runs;
+			mergeRuns(a, tmp, less_than, bounds, first, last);
+			merged.push_back(bounds[first]);
+		}
+		merged.push_back(n);
+		streamFence();
+
+		a.swap(tmp);
+		bounds.swap(merged);
+		++stats.passes;
+		stats.bytesMoved += bytesPerPass;
+	}
+	return stats;
+}
+
+#endif
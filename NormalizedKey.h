@@ -0,0 +1,500 @@
+/*
+	This is the NormalizedKey.h header file.
+	This file contains KeySchema, which encodes the sort columns of a record
+	(e.g. tenant ascending, timestamp descending, price ascending) into one
+	fixed-width byte string per record, and sortByNormalizedKey, which sorts
+	records by those byte strings instead of calling a multi-column Comparator.
+
+	The encoding is chosen so that comparing two encoded keys with memcmp
+	gives the same order as comparing the columns one by one:
+	  - integers are written big-endian, with the sign bit of signed types flipped;
+	  - floats are written as their IEEE bits, with every bit flipped for
+	    negative numbers and only the sign bit flipped otherwise; -0.0 is
+	    written as 0.0, and every NaN sorts first or last;
+	  - strings are written as their first prefixLength bytes, padded with
+	    zeros, followed by their length (capped at prefixLength + 1);
+	  - descending columns have every byte of their encoding flipped.
+	Strings longer than their prefix compare equal when their prefixes are
+	equal; pass a tie-breaking Comparator to sortByNormalizedKey to order them.
+
+	Keys of up to 8 bytes are sorted as 64-bit integers with an LSD radix
+	sort. Longer keys are sorted with an MSD radix sort on the key bytes,
+	or, when there are only a few, with quicksort (or mergeSort, if stable)
+	from Sort.h on their first 8 bytes, falling back to memcmp on ties.
+	The records themselves are moved only once, when the sorted order is
+	applied at the end.
+
+	This pays off when comparing records is expensive (string columns,
+	several columns, a Comparator that is not inlined); for a single
+	numeric column, quicksort with a plain Comparator is as fast.
+*/
+
+#ifndef NORMALIZED_KEY_H
+#define NORMALIZED_KEY_H
+
+#include "Sort.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/**
+ * Longest string prefix a column can keep; its length must fit in one byte.
+ */
+const int MAX_KEY_PREFIX = 254;
+
+/**
+ * Keys longer than 8 bytes are radix sorted when there are at least this
+ * many; fewer are sorted by comparison.
+ */
+const int NORMALIZED_RADIX_CUTOFF = 4096;
+
+/**
+ * Groups of at most this many keys are insertion sorted by the radix sort.
+ */
+const int KEY_ROW_INSERTION_CUTOFF = 16;
+
+enum class KeyOrder
+{
+	Ascending,
+	Descending
+};
+
+/**
+ * Where NaN sorts in an ascending float column.
+ */
+enum class NanOrder
+{
+	First,
+	Last
+};
+
+/**
+ * Internal method that writes the low width bytes of value to out, most significant first.
+ */
+inline void encodeUnsigned(uint64_t value, int width, unsigned char* out)
+{
+	for (int b = width - 1; b >= 0; --b)
+	{
+		out[b] = (unsigned char)(value & 0xff);
+		value >>= 8;
+	}
+}
+
+/**
+ * Internal method that encodes an integer so unsigned byte order is numeric order.
+ */
+template <typename Integer>
+void encodeInteger(Integer value, unsigned char* out)
+{
+	typedef typename make_unsigned<Integer>::type Unsigned;
+	Unsigned bits = Unsigned(value);
+	if (is_signed<Integer>::value)
+		bits ^= Unsigned(1) << (8 * sizeof(Integer) - 1);
+	encodeUnsigned(bits, sizeof(Integer), out);
+}
+
+/**
+ * Internal method that encodes a float or double so unsigned byte order is numeric order.
+ */
+template <typename Float>
+void encodeFloat(Float value, NanOrder nanOrder, unsigned char* out)
+{
+	typedef typename conditional<sizeof(Float) == 4, uint32_t, uint64_t>::type Bits;
+	const Bits sign = Bits(1) << (8 * sizeof(Float) - 1);
+
+	Bits bits;
+	if (value != value)
+		bits = nanOrder == NanOrder::Last ? ~Bits(0) : Bits(0);
+	else
+	{
+		if (value == 0)
+			value = 0;	// -0.0 and 0.0 are equal
+		memcpy(&bits, &value, sizeof(Float));
+		bits = (bits & sign) ? ~bits : (bits | sign);
+	}
+	encodeUnsigned(bits, sizeof(Float), out);
+}
+
+/**
+ * Internal method that encodes the first prefixLength bytes of s and its length.
+ * Writes prefixLength + 1 bytes.
+ */
+inline void encodeStringPrefix(string_view s, int prefixLength, unsigned char* out)
+{
+	size_t kept = s.size() < size_t(prefixLength) ? s.size() : size_t(prefixLength);
+	memcpy(out, s.data(), kept);
+	memset(out + kept, 0, prefixLength - kept);
+	out[prefixLength] = (unsigned char)(s.size() <= size_t(prefixLength) ? s.size() : prefixLength + 1);
+}
+
+/**
+ * The sort columns of a Record and how to encode them.
+ * Columns are compared in the order they are added.
+ * Each add method takes a function that returns the column's value from a record.
+ */
+template <typename Record>
+class KeySchema
+{
+public:
+	/**
+	 * Adds an integer column; its width is the size of the integer type returned.
+	 */
+	template <typename Extract>
+	KeySchema& addInt(Extract extract, KeyOrder order = KeyOrder::Ascending)
+	{
+		typedef typename decay<decltype(extract(declval<const Record&>()))>::type Integer;
+		static_assert(is_integral<Integer>::value, "addInt needs an integer column");
+		return addColumn(sizeof(Integer), order, [extract](const Record& r, unsigned char* out)
+		{
+			encodeInteger<Integer>(extract(r), out);
+		});
+	}
+
+	/**
+	 * Adds a float or double column. NaN sorts as given by nanOrder
+	 * for an ascending column, and at the other end for a descending one.
+	 */
+	template <typename Extract>
+	KeySchema& addFloat(Extract extract, KeyOrder order = KeyOrder::Ascending, NanOrder nanOrder = NanOrder::Last)
+	{
+		typedef typename decay<decltype(extract(declval<const Record&>()))>::type Float;
+		static_assert(is_floating_point<Float>::value && (sizeof(Float) == 4 || sizeof(Float) == 8),
+			"addFloat needs a float or double column");
+		return addColumn(sizeof(Float), order, [extract, nanOrder](const Record& r, unsigned char* out)
+		{
+			encodeFloat<Float>(extract(r), nanOrder, out);
+		});
+	}
+
+	/**
+	 * Adds a string column compared on its first prefixLength bytes
+	 * (at most MAX_KEY_PREFIX). extract may return anything convertible
+	 * to string_view.
+	 */
+	template <typename Extract>
+	KeySchema& addString(Extract extract, int prefixLength, KeyOrder order = KeyOrder::Ascending)
+	{
+		if (prefixLength < 0)
+			prefixLength = 0;
+		if (prefixLength > MAX_KEY_PREFIX)
+			prefixLength = MAX_KEY_PREFIX;
+		return addColumn(prefixLength + 1, order, [extract, prefixLength](const Record& r, unsigned char* out)
+		{
+			encodeStringPrefix(string_view(extract(r)), prefixLength, out);
+		}, prefixLength);
+	}
+
+	/**
+	 * Returns the number of bytes in one encoded key.
+	 */
+	int width() const { return keyWidth; }
+
+	/**
+	 * Writes the width() byte key of r to out.
+	 */
+	void encode(const Record& r, unsigned char* out) const
+	{
+		for (const Column& c : columns)
+		{
+			c.encode(r, out);
+			if (c.order == KeyOrder::Descending)
+				for (int b = 0; b < c.width; ++b)
+					out[b] = (unsigned char)~out[b];
+			out += c.width;
+		}
+	}
+
+	/**
+	 * Returns true if the records with keys x and y cannot be ordered by
+	 * their keys alone: the keys are equal up to a string column that holds
+	 * only a prefix of the string, or equal on every column.
+	 */
+	bool needsTieBreak(const unsigned char* x, const unsigned char* y) const
+	{
+		for (const Column& c : columns)
+		{
+			if (memcmp(x, y, c.width) != 0)
+				return false;
+			if (c.prefixLength >= 0)
+			{
+				unsigned char length = c.order == KeyOrder::Descending ? (unsigned char)~x[c.prefixLength] : x[c.prefixLength];
+				if (length > c.prefixLength)
+					return true;
+			}
+			x += c.width;
+			y += c.width;
+		}
+		return true;
+	}
+
+	/**
+	 * Returns the keys of every record, one after the other.
+	 */
+	vector<unsigned char> encodeAll(const vector<Record>& records) const
+	{
+		vector<unsigned char> keys(records.size() * keyWidth);
+		for (size_t i = 0; i < records.size(); ++i)
+			encode(records[i], keys.data() + i * keyWidth);
+		return keys;
+	}
+
+private:
+	struct Column
+	{
+		int width;
+		KeyOrder order;
+		function<void(const Record&, unsigned char*)> encode;
+		int prefixLength;	// Bytes of a string column's prefix, -1 for other columns
+	};
+
+	KeySchema& addColumn(int width, KeyOrder order, function<void(const Record&, unsigned char*)> encode,
+		int prefixLength = -1)
+	{
+		columns.push_back(Column{ width, order, std::move(encode), prefixLength });
+		keyWidth += width;
+		return *this;
+	}
+
+	vector<Column> columns;
+	int keyWidth = 0;
+};
+
+/**
+ * The first 8 bytes of an encoded key, as an integer, and the index of its record.
+ */
+struct NormalizedKeyRef
+{
+	uint64_t prefix;
+	int index;
+};
+
+/**
+ * Internal method that returns the first 8 bytes of key (zero padded) as a big-endian integer.
+ */
+inline uint64_t keyPrefix(const unsigned char* key, int width)
+{
+	uint64_t prefix = 0;
+	for (int b = 0; b < 8; ++b)
+		prefix = (prefix << 8) | (b < width ? key[b] : 0);
+	return prefix;
+}
+
+/**
+ * Internal method that sorts refs by prefix with an LSD radix sort.
+ * Only the top width bytes are looked at; passes where every key has
+ * the same byte are skipped. Stable.
+ */
+inline void radixSortKeyRefs(vector<NormalizedKeyRef>& refs, int width)
+{
+	int n = refs.size();
+	vector<NormalizedKeyRef> tmp(n);
+
+	for (int shift = 8 * (8 - width); shift < 64; shift += 8)
+	{
+		int count[257] = { 0 };
+		for (int i = 0; i < n; ++i)
+			++count[((refs[i].prefix >> shift) & 0xff) + 1];
+		if (count[((refs[0].prefix >> shift) & 0xff) + 1] == n)
+			continue;
+
+		for (int d = 0; d < 256; ++d)
+			count[d + 1] += count[d];
+		for (int i = 0; i < n; ++i)
+			tmp[count[(refs[i].prefix >> shift) & 0xff]++] = refs[i];
+		refs.swap(tmp);
+	}
+}
+
+/**
+ * Internal method that sorts n rows of stride bytes by bytes byte..width-1
+ * with an MSD radix sort. Each row is a key followed by its record's index.
+ * Rows are moved whole, so keys are never looked up through an index;
+ * groups of at most KEY_ROW_INSERTION_CUTOFF rows are insertion sorted
+ * with memcmp. tmp has room for n rows. Stable.
+ */
+inline void radixSortKeyRows(unsigned char* rows, unsigned char* tmp, int n, int width, int stride, int byte)
+{
+	// Skip bytes that are the same in every row
+	int count[256];
+	for (; byte < width && n > KEY_ROW_INSERTION_CUTOFF; ++byte)
+	{
+		memset(count, 0, sizeof(count));
+		for (int i = 0; i < n; ++i)
+			++count[rows[size_t(i) * stride + byte]];
+		if (count[rows[byte]] != n)
+			break;
+	}
+	if (byte == width)
+		return;
+
+	if (n <= KEY_ROW_INSERTION_CUTOFF)
+	{
+		// tmp holds the row being inserted
+		for (int p = 1; p < n; ++p)
+		{
+			memcpy(tmp, rows + size_t(p) * stride, stride);
+			int j;
+			for (j = p; j > 0 && memcmp(tmp + byte, rows + size_t(j - 1) * stride + byte, width - byte) < 0; --j)
+				memcpy(rows + size_t(j) * stride, rows + size_t(j - 1) * stride, stride);
+			memcpy(rows + size_t(j) * stride, tmp, stride);
+		}
+		return;
+	}
+
+	int start[256];
+	for (int d = 0, sum = 0; d < 256; ++d)
+	{
+		start[d] = sum;
+		sum += count[d];
+	}
+	int position[256];
+	memcpy(position, start, sizeof(position));
+	for (int i = 0; i < n; ++i)
+	{
+		const unsigned char* row = rows + size_t(i) * stride;
+		memcpy(tmp + size_t(position[row[byte]]++) * stride, row, stride);
+	}
+	memcpy(rows, tmp, size_t(n) * stride);
+
+	for (int d = 0; d < 256; ++d)
+		if (count[d] > 1)
+			radixSortKeyRows(rows + size_t(start[d]) * stride, tmp + size_t(start[d]) * stride,
+				count[d], width, stride, byte + 1);
+}
+
+/**
+ * Internal method that returns the order of n keys of width bytes stored one after the other.
+ */
+inline vector<int> normalizedKeyOrder(const vector<unsigned char>& keys, int n, int width, bool stable)
+{
+	vector<int> order(n);
+	const unsigned char* base = keys.data();
+
+	if (width > 8 && n >= NORMALIZED_RADIX_CUTOFF)
+	{
+		// Append each record's index to its key and radix sort the rows
+		int stride = width + int(sizeof(int));
+		vector<unsigned char> rows(size_t(n) * stride);
+		for (int i = 0; i < n; ++i)
+		{
+			memcpy(rows.data() + size_t(i) * stride, base + size_t(i) * width, width);
+			memcpy(rows.data() + size_t(i) * stride + width, &i, sizeof(int));
+		}
+
+		// Start after the bytes every key shares, found in one pass
+		int common = width;
+		for (int i = 1; i < n && common > 0; ++i)
+			for (int b = 0; b < common; ++b)
+				if (base[size_t(i) * width + b] != base[b])
+				{
+					common = b;
+					break;
+				}
+
+		vector<unsigned char> tmp(rows.size());
+		radixSortKeyRows(rows.data(), tmp.data(), n, width, stride, common);
+		for (int i = 0; i < n; ++i)
+			memcpy(&order[i], rows.data() + size_t(i) * stride + width, sizeof(int));
+		return order;
+	}
+
+	vector<NormalizedKeyRef> refs(n);
+	for (int i = 0; i < n; ++i)
+		refs[i] = NormalizedKeyRef{ keyPrefix(base + size_t(i) * width, width), i };
+
+	if (n > 1 && width > 0 && width <= 8)
+		radixSortKeyRefs(refs, width);
+	else if (n > 1 && width > 8)
+	{
+		auto less_than = [base, width](const NormalizedKeyRef& x, const NormalizedKeyRef& y)
+		{
+			if (x.prefix != y.prefix)
+				return x.prefix < y.prefix;
+			return memcmp(base + size_t(x.index) * width + 8, base + size_t(y.index) * width + 8, width - 8) < 0;
+		};
+		if (stable)
+			mergeSort(refs, less_than);
+		else
+			quicksort(refs, less_than);
+	}
+
+	for (int i = 0; i < n; ++i)
+		order[i] = refs[i].index;
+	return order;
+}
+
+/**
+ * Returns the order of records by their keys under schema:
+ * the index of the record that belongs at each position.
+ * If stable, records with equal keys keep their order.
+ */
+template <typename Record>
+vector<int> normalizedKeyOrder(const vector<Record>& records, const KeySchema<Record>& schema, bool stable = false)
+{
+	return normalizedKeyOrder(schema.encodeAll(records), records.size(), schema.width(), stable);
+}
+
+/**
+ * Moves a[order[i]] to position i for every i.
+ * The items are gathered into a new array: the reads are independent of
+ * each other, which is much faster than following the cycles of order in
+ * place, where every read waits for the one before it.
+ */
+template <typename Comparable>
+void applyPermutation(vector<Comparable>& a, const vector<int>& order)
+{
+	vector<Comparable> sorted;
+	sorted.reserve(a.size());
+	for (int index : order)
+		sorted.push_back(std::move(a[index]));
+	a.swap(sorted);
+}
+
+/**
+ * Sorts records by their keys under schema.
+ * If stable, records with equal keys keep their order.
+ */
+template <typename Record>
+void sortByNormalizedKey(vector<Record>& records, const KeySchema<Record>& schema, bool stable = false)
+{
+	vector<int> order = normalizedKeyOrder(records, schema, stable);
+	applyPermutation(records, order);
+}
+
+/**
+ * Sorts records by their keys under schema, then sorts each run of
+ * records the keys cannot order with tie_break, e.g. the full multi-column
+ * Comparator, to order strings that differ after their prefix.
+ * A run is a stretch of records whose keys are equal up to a string column
+ * cut short by its prefix (the columns after it are sorted again too), or
+ * equal on every column.
+ */
+template <typename Record, typename Comparator>
+void sortByNormalizedKey(vector<Record>& records, const KeySchema<Record>& schema, Comparator tie_break)
+{
+	int n = records.size();
+	int width = schema.width();
+	vector<unsigned char> keys = schema.encodeAll(records);
+	vector<int> order = normalizedKeyOrder(keys, n, width, false);
+
+	// Find the runs before the records move, while keys still matches their indices
+	vector<pair<int, int>> runs;
+	for (int i = 0, start = 0; i < n; ++i)
+		if (i + 1 == n || !schema.needsTieBreak(keys.data() + size_t(order[i]) * width, keys.data() + size_t(order[i + 1]) * width))
+		{
+			if (i > start)
+				runs.push_back(make_pair(start, i));
+			start = i + 1;
+		}
+
+	applyPermutation(records, order);
+	for (auto& run : runs)
+		quicksort(records, tie_break, run.first, run.second);
+}
+
+#endif
@@ -0,0 +1,223 @@
+/*
+	This is the SampleSort.h header file.
+	This file contains the parallel sample sort, which spreads an unstable
+	sort across several threads.
+
+	A sorted random sample picks numBuckets - 1 splitters. Every item is then
+	classified into a bucket in parallel by walking a splitter tree with
+	branchless steps, and scattered into that bucket. Each thread sorts its
+	own buckets with quicksort from Sort.h and moves them back in place.
+
+	If the sample repeats a splitter, the input holds many copies of it.
+	Every splitter then also gets an equality bucket for the items equal to
+	it. Those buckets need no sorting, so a heavily repeated item does not
+	leave one thread with most of the work.
+
+	Bucket storage is allocated and first written by the thread that later
+	sorts the bucket. With the default first-touch memory policy on Linux
+	this places every bucket on the NUMA node of the thread that sorts it.
+*/
+
+#ifndef SAMPLE_SORT_H
+#define SAMPLE_SORT_H
+
+#include "Sort.h"
+#include "SortThreads.h"
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * Arrays smaller than this are sorted with quicksort on the calling thread.
+ */
+const int SAMPLE_SORT_CUTOFF = 1 << 14;
+
+/**
+ * Number of sample items taken per bucket.
+ */
+const int SAMPLE_OVERSAMPLING = 32;
+
+/**
+ * Internal method for sample sort.
+ * Fills the splitter tree for buckets lo..hi-1 rooted at node, in
+ * implicit (Eytzinger) layout: the children of node are 2 * node and 2 * node + 1.
+ * sample is a sorted array of sample items.
+ */
+template <typename Comparable>
+void buildSplitterTree(vector<Comparable>& tree, const vector<Comparable>& sample,
+	int numBuckets, int node, int lo, int hi)
+{
+	if (hi - lo <= 1)
+		return;
+
+	int mid = (lo + hi) / 2;
+	tree[node] = sample[(long long)mid * sample.size() / numBuckets];
+	buildSplitterTree(tree, sample, numBuckets, 2 * node, lo, mid);
+	buildSplitterTree(tree, sample, numBuckets, 2 * node + 1, mid, hi);
+}
+
+/**
+ * Internal method for sample sort.
+ * Returns the bucket of x by walking logBuckets levels of the splitter tree.
+ * Each step adds the comparison result to the index instead of branching on it.
+ */
+template <typename Comparable, typename Comparator>
+inline int classify(const vector<Comparable>& tree, Comparator less_than, int logBuckets, const Comparable& x)
+{
+	int j = 1;
+	for (int level = 0; level < logBuckets; ++level)
+		j = 2 * j + int(less_than(tree[j], x));
+	return j - (1 << logBuckets);
+}
+
+/**
+ * Parallel sample sort.
+ * a is an array of Comparable items.
+ * numThreads is the most threads used to classify, scatter and sort; fewer
+ * are used if a thread would get less than parallelGrain items (from the sort profile).
+ * Not stable.
+ */
+template <typename Comparable, typename Comparator>
+void sampleSort(vector<Comparable>& a, Comparator less_than, int numThreads)
+{
+	int n = a.size();
+
+	// Give every thread at least parallelGrain items
+	int parallelGrain = sortProfile<Comparable>().parallelGrain;
+	if (numThreads > n / parallelGrain)
+		numThreads = n / parallelGrain;
+
+	if (numThreads <= 1 || n < SAMPLE_SORT_CUTOFF)
+	{
+		quicksort(a, less_than);
+		return;
+	}
+
+	// A power of two buckets, a few per thread so the sorting load can be balanced
+	int logBuckets = 1;
+	while ((1 << logBuckets) < 4 * numThreads && logBuckets < 10)
+		++logBuckets;
+	int numBuckets = 1 << logBuckets;
+
+	SORT_TRACE_SCOPE("sample sort", n);
+
+	// Oversample and pick evenly spaced splitters from the sorted sample
+	vector<Comparable> sample;
+	minstd_rand random(n);
+	for (int i = 0; i < numBuckets * SAMPLE_OVERSAMPLING; ++i)
+		sample.push_back(a[random() % n]);
+	quicksort(sample, less_than);
+
+	vector<Comparable> tree(numBuckets);
+	buildSplitterTree(tree, sample, numBuckets, 1, 0, numBuckets);
+
+	// splitters[b] is the largest item that goes to bucket b of the tree
+	vector<Comparable> splitters;
+	for (int b = 1; b < numBuckets; ++b)
+		splitters.push_back(sample[(long long)b * sample.size() / numBuckets]);
+
+	// With a repeated splitter, bucket 2b holds the items below splitters[b]
+	// and bucket 2b + 1 the items equal to it
+	bool equalityBuckets = false;
+	for (int b = 1; b < numBuckets - 1; ++b)
+		if (!less_than(splitters[b - 1], splitters[b]))
+			equalityBuckets = true;
+	int treeBuckets = numBuckets;
+	if (equalityBuckets)
+		numBuckets *= 2;
+
+	auto bucketOfItem = [&](const Comparable& x)
+	{
+		int b = classify(tree, less_than, logBuckets, x);
+		if (!equalityBuckets)
+			return b;
+		return 2 * b + int(b < treeBuckets - 1 && !less_than(x, splitters[b]));
+	};
+	auto isEqualityBucket = [&](int b) { return equalityBuckets && b % 2 == 1; };
+
+	// Classify: every thread labels the items of its block and counts its bucket sizes
+	vector<uint16_t> bucketOf(n);
+	vector<int> counts(numThreads * numBuckets, 0);
+
+	runOnThreads(numThreads, [&](int t)
+	{
+		SORT_TRACE_SCOPE("classify", (long long)(t + 1) * n / numThreads - (long long)t * n / numThreads);
+		int* count = &counts[t * numBuckets];
+		for (int i = (long long)t * n / numThreads; i < (long long)(t + 1) * n / numThreads; ++i)
+		{
+			bucketOf[i] = bucketOfItem(a[i]);
+			++count[bucketOf[i]];
+		}
+	});
+
+	// Turn the counts into each thread's write position within each bucket
+	vector<int> bucketSize(numBuckets, 0), bucketStart(numBuckets + 1, 0);
+	for (int b = 0; b < numBuckets; ++b)
+	{
+		for (int t = 0; t < numThreads; ++t)
+		{
+			int c = counts[t * numBuckets + b];
+			counts[t * numBuckets + b] = bucketSize[b];
+			bucketSize[b] += c;
+		}
+		bucketStart[b + 1] = bucketStart[b] + bucketSize[b];
+	}
+
+	// Give each thread a contiguous range of buckets with about the same number of items to sort.
+	// Equality buckets are only moved back, which is cheap next to sorting, so they do not count
+	vector<long long> sortedBefore(numBuckets + 1, 0);
+	for (int b = 0; b < numBuckets; ++b)
+		sortedBefore[b + 1] = sortedBefore[b] + (isEqualityBucket(b) ? 0 : bucketSize[b]);
+	vector<int> firstBucket(numThreads + 1, numBuckets);
+	firstBucket[0] = 0;
+	for (int b = 0, t = 1; b < numBuckets && t < numThreads; ++b)
+		if (sortedBefore[b + 1] >= t * sortedBefore[numBuckets] / numThreads)
+			firstBucket[t++] = b + 1;
+
+	// Each thread allocates the buckets it will sort, so they are local to it
+	vector<vector<Comparable>> buckets(numBuckets);
+	runOnThreads(numThreads, [&](int t)
+	{
+		SORT_TRACE_SCOPE("allocate buckets", bucketStart[firstBucket[t + 1]] - bucketStart[firstBucket[t]]);
+		for (int b = firstBucket[t]; b < firstBucket[t + 1]; ++b)
+			buckets[b].resize(bucketSize[b]);
+	});
+
+	// Scatter: every thread moves the items of its block into the buckets
+	runOnThreads(numThreads, [&](int t)
+	{
+		SORT_TRACE_SCOPE("scatter", (long long)(t + 1) * n / numThreads - (long long)t * n / numThreads);
+		int* position = &counts[t * numBuckets];
+		for (int i = (long long)t * n / numThreads; i < (long long)(t + 1) * n / numThreads; ++i)
+			buckets[bucketOf[i]][position[bucketOf[i]]++] = std::move(a[i]);
+	});
+
+	// Sort each bucket and move it back into its place in a
+	runOnThreads(numThreads, [&](int t)
+	{
+		SORT_TRACE_SCOPE("sort buckets", bucketStart[firstBucket[t + 1]] - bucketStart[firstBucket[t]]);
+		for (int b = firstBucket[t]; b < firstBucket[t + 1]; ++b)
+		{
+			if (!isEqualityBucket(b))
+				quicksort(buckets[b], less_than);
+			for (int i = 0; i < bucketSize[b]; ++i)
+				a[bucketStart[b] + i] = std::move(buckets[b][i]);
+			vector<Comparable>().swap(buckets[b]);
+		}
+	});
+}
+
+/**
+ * Parallel sample sort algorithm (driver).
+ * Uses every hardware thread.
+ */
+template <typename Comparable, typename Comparator>
+void sampleSort(vector<Comparable>& a, Comparator less_than)
+{
+	int numThreads = thread::hardware_concurrency();
+	sampleSort(a, less_than, numThreads > 0 ? numThreads : 1);
+}
+
+#endif
@@ -0,0 +1,285 @@
+/*
+	This is the Semisort.h header file.
+	This file contains semisort, which moves the records with equal keys
+	next to each other without putting the groups in any order. Grouping
+	for an aggregation (group by key) needs no more than that, and a
+	semisort does it in expected O(n) instead of the O(n log n) of a sort.
+
+	Records are hashed by key. A random sample finds the heavy keys, those
+	common enough to fill a bucket on their own, and each gets a bucket of
+	its own. Every other key goes to one of the light buckets, picked by its
+	hash. Classifying and scattering into the buckets are split between
+	threads as in the sample sort ("SampleSort.h"). Each thread then groups
+	the equal keys of its light buckets with a small hash table and moves
+	the groups back in place. A heavy bucket is a group already.
+
+	semisort returns the group boundaries: group g is a[bounds[g]] ..
+	a[bounds[g + 1] - 1], and the last bound is a.size(). It is not stable.
+*/
+
+#ifndef SEMISORT_H
+#define SEMISORT_H
+
+#include "Sort.h"
+#include "SortThreads.h"
+#include "SortVerify.h"
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+/**
+ * Each thread is given at least this many records.
+ */
+const int SEMISORT_CUTOFF = 1 << 14;
+
+/**
+ * Expected number of records in each light bucket.
+ */
+const int SEMISORT_BUCKET_SIZE = 1 << 11;
+
+/**
+ * One record in this many is sampled, but at least SEMISORT_MIN_SAMPLE.
+ */
+const int SEMISORT_SAMPLE_RATE = 64;
+const int SEMISORT_MIN_SAMPLE = 1024;
+
+/**
+ * A key seen this many times in the sample gets a bucket of its own.
+ * With one record in 64 sampled, that is a key of about half a light bucket or more.
+ */
+const int SEMISORT_HEAVY_SAMPLES = 16;
+
+/**
+ * Internal method for semisort.
+ * Returns the smallest power of two that is at least n.
+ */
+inline int semisortTableSize(int n)
+{
+	int size = 1;
+	while (size < n)
+		size *= 2;
+	return size;
+}
+
+/**
+ * Semisort algorithm.
+ * Moves the records of a with equal keyOf(record) next to each other and
+ * returns the boundaries of the groups.
+ * hasher maps a key to 64 bits, same tells whether two keys are equal;
+ * keys that are the same must hash the same (ItemHash hashes -0.0 as 0.0
+ * for equal_to). numThreads is the number of threads to use.
+ */
+template <typename Record, typename KeyOf, typename Hasher = ItemHash, typename KeyEqual = equal_to<>>
+vector<int> semisort(vector<Record>& a, KeyOf keyOf, int numThreads, Hasher hasher = Hasher(), KeyEqual same = KeyEqual())
+{
+	typedef typename decay<decltype(keyOf(a[0]))>::type Key;
+	int n = a.size();
+	vector<int> bounds;
+	if (n == 0)
+	{
+		bounds.push_back(0);
+		return bounds;
+	}
+
+	if (numThreads > n / SEMISORT_CUTOFF)
+		numThreads = n / SEMISORT_CUTOFF;
+	if (numThreads < 1)
+		numThreads = 1;
+
+	SORT_TRACE_SCOPE("semisort", n);
+
+	auto keyHash = [&](const Record& x) { return mixItemHash(hasher(keyOf(x))); };
+
+	// Sample and count the hashes; a run of equal hashes long enough is a heavy key.
+	// A single light bucket has nothing to split off, so small arrays are not sampled
+	int sampleSize = n / SEMISORT_SAMPLE_RATE > SEMISORT_MIN_SAMPLE ? n / SEMISORT_SAMPLE_RATE : SEMISORT_MIN_SAMPLE;
+	if (n <= SEMISORT_BUCKET_SIZE)
+		sampleSize = 0;
+	vector<pair<unsigned long long, int>> sample;
+	minstd_rand random(n);
+	for (int i = 0; i < sampleSize; ++i)
+	{
+		int j = random() % n;
+		sample.push_back({ keyHash(a[j]), j });
+	}
+	std::sort(sample.begin(), sample.end());
+
+	vector<Key> heavyKeys;
+	vector<unsigned long long> heavyHash;
+	for (int i = 0, j; i < sampleSize; i = j)
+	{
+		for (j = i + 1; j < sampleSize && sample[j].first == sample[i].first; ++j)
+			;
+		if (j - i >= SEMISORT_HEAVY_SAMPLES)
+		{
+			heavyKeys.push_back(keyOf(a[sample[i].second]));
+			heavyHash.push_back(sample[i].first);
+		}
+	}
+	int numHeavy = heavyKeys.size();
+
+	// Open addressing table from a heavy key's hash to its bucket
+	int heavyMask = semisortTableSize(2 * numHeavy + 1) - 1;
+	vector<int> heavySlot(heavyMask + 1, -1);
+	for (int h = 0; h < numHeavy; ++h)
+	{
+		int slot = heavyHash[h] & heavyMask;
+		while (heavySlot[slot] != -1)
+			slot = (slot + 1) & heavyMask;
+		heavySlot[slot] = h;
+	}
+
+	// Light buckets are picked by the top bits of the hash; the local tables use the bottom bits
+	int logLight = 0;
+	while ((1LL << logLight) * SEMISORT_BUCKET_SIZE < n)
+		++logLight;
+	int numBuckets = numHeavy + (1 << logLight);
+
+	auto bucketOfRecord = [&](const Record& x)
+	{
+		unsigned long long h = keyHash(x);
+		if (numHeavy > 0)
+			for (int slot = h & heavyMask; heavySlot[slot] != -1; slot = (slot + 1) & heavyMask)
+			{
+				int b = heavySlot[slot];
+				if (heavyHash[b] == h && same(heavyKeys[b], keyOf(x)))
+					return b;
+			}
+		return numHeavy + (logLight > 0 ? int(h >> (64 - logLight)) : 0);
+	};
+
+	// Classify: every thread labels the records of its block and counts its bucket sizes
+	vector<int> bucketOf(n);
+	vector<int> counts((long long)numThreads * numBuckets, 0);
+
+	runOnThreads(numThreads, [&](int t)
+	{
+		SORT_TRACE_SCOPE("classify", (long long)(t + 1) * n / numThreads - (long long)t * n / numThreads);
+		int* count = &counts[(long long)t * numBuckets];
+		for (int i = (long long)t * n / numThreads; i < (long long)(t + 1) * n / numThreads; ++i)
+		{
+			bucketOf[i] = bucketOfRecord(a[i]);
+			++count[bucketOf[i]];
+		}
+	});
+
+	// Turn the counts into each thread's write position within each bucket
+	vector<int> bucketStart(numBuckets + 1, 0);
+	for (int b = 0; b < numBuckets; ++b)
+	{
+		int size = 0;
+		for (int t = 0; t < numThreads; ++t)
+		{
+			int c = counts[(long long)t * numBuckets + b];
+			counts[(long long)t * numBuckets + b] = bucketStart[b] + size;
+			size += c;
+		}
+		bucketStart[b + 1] = bucketStart[b] + size;
+	}
+
+	// Scatter: every thread moves the records of its block into their buckets
+	vector<Record> tmp(n);
+	runOnThreads(numThreads, [&](int t)
+	{
+		SORT_TRACE_SCOPE("scatter", (long long)(t + 1) * n / numThreads - (long long)t * n / numThreads);
+		int* position = &counts[(long long)t * numBuckets];
+		for (int i = (long long)t * n / numThreads; i < (long long)(t + 1) * n / numThreads; ++i)
+			tmp[position[bucketOf[i]]++] = std::move(a[i]);
+	});
+	vector<int>().swap(bucketOf);
+
+	// Give each thread a contiguous range of buckets holding about n / numThreads records
+	vector<int> firstBucket(numThreads + 1, numBuckets);
+	firstBucket[0] = 0;
+	for (int b = 0, t = 1; b < numBuckets && t < numThreads; ++b)
+		if (bucketStart[b + 1] >= (long long)t * n / numThreads)
+			firstBucket[t++] = b + 1;
+
+	// Group each bucket and move it back into its place in a
+	vector<vector<int>> groupStarts(numThreads);
+	runOnThreads(numThreads, [&](int t)
+	{
+		SORT_TRACE_SCOPE("group buckets", bucketStart[firstBucket[t + 1]] - bucketStart[firstBucket[t]]);
+		vector<int>& starts = groupStarts[t];
+		vector<int> slotGroup, groupOf, groupFirst, groupPosition;
+		vector<unsigned long long> groupHash;
+
+		for (int b = firstBucket[t]; b < firstBucket[t + 1]; ++b)
+		{
+			int first = bucketStart[b], size = bucketStart[b + 1] - first;
+			if (size == 0)
+				continue;
+
+			// A heavy bucket holds one key
+			if (b < numHeavy)
+			{
+				starts.push_back(first);
+				for (int i = first; i < first + size; ++i)
+					a[i] = std::move(tmp[i]);
+				continue;
+			}
+
+			// Number the distinct keys of the bucket in order of first appearance
+			int mask = semisortTableSize(2 * size) - 1;
+			slotGroup.assign(mask + 1, -1);
+			groupOf.resize(size);
+			groupFirst.clear();
+			groupHash.clear();
+			for (int i = 0; i < size; ++i)
+			{
+				unsigned long long h = keyHash(tmp[first + i]);
+				int slot = h & mask;
+				for (; slotGroup[slot] != -1; slot = (slot + 1) & mask)
+				{
+					int g = slotGroup[slot];
+					if (groupHash[g] == h && same(keyOf(tmp[groupFirst[g]]), keyOf(tmp[first + i])))
+						break;
+				}
+				if (slotGroup[slot] == -1)
+				{
+					slotGroup[slot] = groupFirst.size();
+					groupFirst.push_back(first + i);
+					groupHash.push_back(h);
+				}
+				groupOf[i] = slotGroup[slot];
+			}
+
+			// Count each group's records, then lay the groups out one after another
+			int numGroups = groupFirst.size();
+			groupPosition.assign(numGroups, 0);
+			for (int i = 0; i < size; ++i)
+				++groupPosition[groupOf[i]];
+			for (int g = 0, position = first; g < numGroups; ++g)
+			{
+				int count = groupPosition[g];
+				groupPosition[g] = position;
+				starts.push_back(position);
+				position += count;
+			}
+			for (int i = 0; i < size; ++i)
+				a[groupPosition[groupOf[i]]++] = std::move(tmp[first + i]);
+		}
+	});
+
+	for (const vector<int>& starts : groupStarts)
+		bounds.insert(bounds.end(), starts.begin(), starts.end());
+	bounds.push_back(n);
+	return bounds;
+}
+
+/**
+ * Semisort algorithm (driver).
+ * Uses every hardware thread.
+ */
+template <typename Record, typename KeyOf>
+vector<int> semisort(vector<Record>& a, KeyOf keyOf)
+{
+	int numThreads = thread::hardware_concurrency();
+	return semisort(a, keyOf, numThreads > 0 ? numThreads : 1);
+}
+
+#endif
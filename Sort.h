@@ -22,6 +22,8 @@
  * Arrays are rearranged with smallest item first.
  */
 
+#include "SortTrace.h"
+#include "SortTuning.h"
 #include <vector>
 #include <functional>
 using namespace std;
@@ -54,6 +56,7 @@ void insertionSort( vector<Comparable> & a , Comparator less_than)
 template <typename Comparable, typename Comparator>
 void insertionSort(vector<Comparable>& a, Comparator less_than, int left, int right)
 {
+	SORT_TRACE_SCOPE("insertion sort", right - left + 1);
 	for (int p = left + 1; p <= right; ++p)
 	{
 		Comparable tmp = std::move(a[p]);
@@ -74,7 +77,7 @@ template <typename Comparable>
 void shellsort( vector<Comparable> & a )
 {
     for( int gap = a.size( ) / 2; gap > 0; gap /= 2 )
-        for( int i = gap; i < a.size( ); ++i )
+        for( int i = gap; i < int( a.size( ) ); ++i )
         {
             Comparable tmp = std::move( a[ i ] );
             int j = i;
@@ -121,18 +124,65 @@ void percDown(vector<Comparable>& a, Comparator less_than, int i, int n)
 	a[i] = std::move(tmp);
 }
 
+/**
+ * Internal method for heapsort on a heap where every node has arity children.
+ * i is the index of an item in the heap.
+ * Returns the index of the first child.
+ */
+inline int firstChild( int i, int arity )
+{
+    return arity * i + 1;
+}
+
+/**
+ * Internal method for heapsort that is used in deleteMax and
+ * buildHeap on a heap where every node has arity children.
+ * i is the position from which to percolate down.
+ * n is the logical size of the heap.
+ */
+template <typename Comparable, typename Comparator>
+void percDown(vector<Comparable>& a, Comparator less_than, int i, int n, int arity)
+{
+	int child;
+	Comparable tmp;
+
+	for (tmp = std::move(a[i]); firstChild(i, arity) < n; i = child)
+	{
+		child = firstChild(i, arity);
+		int lastChild = child + arity < n ? child + arity : n;
+		for (int c = child + 1; c < lastChild; ++c)
+			if (less_than(a[child], a[c]))
+				child = c;
+		if (less_than(tmp, a[child]))
+			a[i] = std::move(a[child]);
+		else
+			break;
+	}
+	a[i] = std::move(tmp);
+}
+
 /**
  * Standard heapsort.
+ * The heap arity comes from the sort profile (2 by default).
  */
 template <typename Comparable, typename Comparator>
 void heapsort(vector<Comparable>& a, Comparator less_than)
 {
-	for (int i = a.size() / 2 - 1; i >= 0; --i)  /* buildHeap */
-		percDown(a, less_than, i, a.size());
-	for (int j = a.size() - 1; j > 0; --j)
+	int n = a.size();
+	int arity = sortProfile<Comparable>().heapArity;
+
 	{
-		std::swap(a[0], a[j]);               /* deleteMax */
-		percDown(a, less_than, 0, j);
+		SORT_TRACE_SCOPE("heap build", n);
+		for (int i = (n - 2 + arity) / arity - 1; i >= 0; --i)  /* buildHeap */
+			percDown(a, less_than, i, n, arity);
+	}
+	{
+		SORT_TRACE_SCOPE("heap extract", n);
+		for (int j = n - 1; j > 0; --j)
+		{
+			std::swap(a[0], a[j]);               /* deleteMax */
+			percDown(a, less_than, 0, j, arity);
+		}
 	}
 }
 
@@ -148,6 +198,7 @@ template <typename Comparable, typename Comparator>
 void merge(vector<Comparable>& a, Comparator less_than, vector<Comparable>& tmpArray,
 	int leftPos, int rightPos, int rightEnd)
 {
+	SORT_TRACE_SCOPE("merge", rightEnd - leftPos + 1);
 	int leftEnd = rightPos - 1;
 	int tmpPos = leftPos;
 	int numElements = rightEnd - leftPos + 1;
@@ -172,6 +223,8 @@ void merge(vector<Comparable>& a, Comparator less_than, vector<Comparable>& tmpA
 
 /**
  * Internal method that makes recursive calls.
+ * Subarrays of at most mergeBlock items (from the sort profile,
+ * 1 by default) are insertion sorted instead of split further.
  * a is an array of Comparable items.
  * tmpArray is an array to place the merged result.
  * left is the left-most index of the subarray.
@@ -181,13 +234,16 @@ template <typename Comparable, typename Comparator>
 void mergeSort(vector<Comparable>& a, Comparator less_than,
 	vector<Comparable>& tmpArray, int left, int right)
 {
-	if (left < right)
+	SORT_TRACE_SCOPE("mergesort", right - left + 1);
+	if (left + sortProfile<Comparable>().mergeBlock <= right)
 	{
 		int center = (left + right) / 2;
 		mergeSort(a, less_than, tmpArray, left, center);
 		mergeSort(a, less_than, tmpArray, center + 1, right);
 		merge(a, less_than, tmpArray, left, center + 1, right);
 	}
+	else
+		insertionSort(a, less_than, left, right);
 }
 
 /**
@@ -210,6 +266,7 @@ void mergeSort(vector<Comparable>& a, Comparator less_than)
 template <typename Comparable, typename Comparator>
 const Comparable& median3(vector<Comparable>& a, Comparator less_than, int left, int right)
 {
+	SORT_TRACE_SCOPE("median3", right - left + 1);
 	int center = (left + right) / 2;
 
 	if (less_than(a[center], a[left]))
@@ -235,14 +292,14 @@ const Comparable& median3(vector<Comparable>& a, Comparator less_than, int left,
 template <typename Comparable, typename Comparator>
 void quicksortMiddle(vector<Comparable>& a, Comparator less_than, int left, int right)
 {
+	SORT_TRACE_SCOPE("quicksort middle", right - left);
 	if (left < right)
 	{
-		// Find middle element in array and assign it to the pivot
+		// Find middle element in array and place it in the last position to anchor it.
+		// The pivot stays there while partitioning, so it is compared by reference, not copied
 		int center = left + (right - left) / 2; 
-		const Comparable pivot = a[center];
-
-		// Place the pivot in the last position to anchor it
 		std::swap(a[center], a[right - 1]); 
+		const Comparable& pivot = a[right - 1];
 
 		int i = left-1, j = right-1;
 
@@ -250,7 +307,7 @@ void quicksortMiddle(vector<Comparable>& a, Comparator less_than, int left, int
 		// and all items on the right are larger than pivot (this is reversed if using greater<int>{} class) 
 		for (; ; ) {
 			while (less_than(a[++i], pivot) && i < right) {};
-			while (less_than(pivot, a[--j]) && j > left) {};
+			while (j > left && less_than(pivot, a[--j])) {};
 			if (i < j) {
 
 				// Place elements on correct side of the pivot
@@ -286,13 +343,13 @@ void quicksortMiddle(vector<Comparable>& a, Comparator less_than, int left, int
 template <typename Comparable, typename Comparator>
 void quicksortFirst(vector<Comparable>& a, Comparator less_than, int left, int right)
 {
+	SORT_TRACE_SCOPE("quicksort first", right - left);
 	if (left < right)
 	{
-		// Find the first element in the array and assign it to the pivot
-		const Comparable pivot = a[left];
-
-		// Place the pivot in the last position to anchor it
+		// Find the first element in the array and place it in the last position to anchor it.
+		// The pivot stays there while partitioning, so it is compared by reference, not copied
 		std::swap(a[left], a[right - 1]); 
+		const Comparable& pivot = a[right - 1];
 
 		int i = left-1, j = right-1;
 
@@ -300,7 +357,7 @@ void quicksortFirst(vector<Comparable>& a, Comparator less_than, int left, int r
 		// and all items on the right are larger than pivot (this is reversed if using greater<int>{} class) 
 		for (; ; ) {
 			while (less_than(a[++i], pivot) && i < right) {};
-			while (less_than(pivot, a[--j]) && j > left) {};
+			while (j > left && less_than(pivot, a[--j])) {};
 
 			if (i < j) {
 				// Place elements on correct side of pivot
@@ -329,7 +386,8 @@ void quicksortFirst(vector<Comparable>& a, Comparator less_than, int left, int r
 
 /**
  * Internal quicksort method that makes recursive calls.
- * Uses median-of-three partitioning and a cutoff of 10.
+ * Uses median-of-three partitioning and the insertion sort
+ * cutoff from the sort profile (10 by default).
  * a is an array of Comparable items.
  * left is the left-most index of the subarray.
  * right is the right-most index of the subarray.
@@ -337,7 +395,8 @@ void quicksortFirst(vector<Comparable>& a, Comparator less_than, int left, int r
 template <typename Comparable, typename Comparator>
 void quicksort(vector<Comparable>& a, Comparator less_than, int left, int right)
 {
-	if (left + 10 <= right)
+	SORT_TRACE_SCOPE("quicksort", right - left + 1);
+	if (left + sortProfile<Comparable>().insertionCutoff <= right)
 	{
 		const Comparable& pivot = median3(a, less_than, left, right);
 
@@ -346,16 +405,19 @@ void quicksort(vector<Comparable>& a, Comparator less_than, int left, int right)
 
 		// Sort the array so that all items on the left are smaller than the pivot
 		// and all items on the right are larger than pivot (this is reversed if using greater<int>{} class) 
-		for (; ; )
 		{
-			while (less_than(a[++i], pivot)) {}
-			while (less_than(pivot, a[--j])) {}
-			if (i < j) {
-				// Place elements on correct side of pivot
-				std::swap(a[i], a[j]);
-			}
-			else {
-				break;
+			SORT_TRACE_SCOPE("partition", right - left + 1);
+			for (; ; )
+			{
+				while (less_than(a[++i], pivot)) {}
+				while (less_than(pivot, a[--j])) {}
+				if (i < j) {
+					// Place elements on correct side of pivot
+					std::swap(a[i], a[j]);
+				}
+				else {
+					break;
+				}
 			}
 		}
 
@@ -366,7 +428,7 @@ void quicksort(vector<Comparable>& a, Comparator less_than, int left, int right)
 		quicksort(a, less_than, i + 1, right);	  // Sort large elements
 	}
 
-	// Do an insertion sort on the subarray if there are 10 items or less
+	// Do an insertion sort on the subarray if it is below the cutoff
 	else {
 		insertionSort(a, less_than, left, right);
 	}
@@ -382,9 +444,281 @@ void quicksort(vector<Comparable>& a, Comparator less_than)
 }
 
 
+/**
+ * Quicksort without recursion.
+ * Uses median-of-three partitioning and the same cutoff as quicksort.
+ * The pivot stays in place and is only compared by reference, so
+ * move-only Comparables (e.g. unique_ptr) can be sorted and heavy ones
+ * are never copied.
+ * The larger side of each partition is pushed on a small explicit stack
+ * and the smaller side is sorted next, so the stack never holds more
+ * than log2(n) subarrays.
+ */
+template <typename Comparable, typename Comparator>
+void quicksortIterative(vector<Comparable>& a, Comparator less_than)
+{
+	int stack[2 * 64];
+	int top = 0;
+	int left = 0, right = a.size() - 1;
+	int cutoff = sortProfile<Comparable>().insertionCutoff;
+	SORT_TRACE_SCOPE("quicksort", a.size());
+
+	for (; ; )
+	{
+		if (left + cutoff <= right)
+		{
+			const Comparable& pivot = median3(a, less_than, left, right);
+
+			// Begin partitioning
+			int i = left, j = right - 1;
+			{
+				SORT_TRACE_SCOPE("partition", right - left + 1);
+				for (; ; )
+				{
+					while (less_than(a[++i], pivot)) {}
+					while (less_than(pivot, a[--j])) {}
+					if (i < j)
+						std::swap(a[i], a[j]);
+					else
+						break;
+				}
+			}
+
+			std::swap(a[i], a[right - 1]);  // Restore pivot
+
+			// Save the larger side for later and sort the smaller side next
+			if (i - left < right - i)
+			{
+				stack[top++] = i + 1;
+				stack[top++] = right;
+				right = i - 1;
+			}
+			else
+			{
+				stack[top++] = left;
+				stack[top++] = i - 1;
+				left = i + 1;
+			}
+		}
+		else
+		{
+			insertionSort(a, less_than, left, right);
+			if (top == 0)
+				break;
+			right = stack[--top];
+			left = stack[--top];
+		}
+	}
+}
+
+
+/**
+ * Smallest subarray partitioned by the multi-pivot quicksorts.
+ * Below it (or below the profile cutoff, if larger) they insertion sort,
+ * which also keeps the pivot sample away from the ends of the subarray.
+ */
+const int MULTI_PIVOT_CUTOFF = 16;
+
+/**
+ * Internal method for the multi-pivot quicksorts.
+ * Picks count items evenly spread over a[left..right] (not including
+ * either end), writes their positions to pos, and sorts them in place.
+ */
+template <typename Comparable, typename Comparator>
+void sortPivotSample(vector<Comparable>& a, Comparator less_than, int left, int right, int* pos, int count)
+{
+	for (int k = 0; k < count; ++k)
+		pos[k] = left + (k + 1) * (right - left) / (count + 1);
+
+	for (int p = 1; p < count; ++p)
+		for (int j = p; j > 0 && less_than(a[pos[j]], a[pos[j - 1]]); --j)
+			std::swap(a[pos[j]], a[pos[j - 1]]);
+}
+
+/**
+ * Internal dual-pivot quicksort method that makes recursive calls.
+ * Uses Yaroslavskiy's partitioning around the 2nd and 4th items of a
+ * sorted sample of 5, into items below p, between p and q, and above q.
+ * The pivots stay at the ends of the subarray while partitioning and
+ * are compared by reference.
+ * a is an array of Comparable items.
+ * left is the left-most index of the subarray.
+ * right is the right-most index of the subarray.
+ */
+template <typename Comparable, typename Comparator>
+void dualPivotQuicksort(vector<Comparable>& a, Comparator less_than, int left, int right)
+{
+	SORT_TRACE_SCOPE("dual pivot quicksort", right - left + 1);
+	int cutoff = sortProfile<Comparable>().insertionCutoff;
+	if (cutoff < MULTI_PIVOT_CUTOFF)
+		cutoff = MULTI_PIVOT_CUTOFF;
+
+	if (left + cutoff > right)
+	{
+		insertionSort(a, less_than, left, right);
+		return;
+	}
+
+	int pos[5];
+	sortPivotSample(a, less_than, left, right, pos, 5);
+	std::swap(a[left], a[pos[1]]);
+	std::swap(a[right], a[pos[3]]);
+	const Comparable& p = a[left];
+	const Comparable& q = a[right];
+
+	// a[left+1..lt) < p, a[lt..k) in [p, q], a(gt..right-1] > q
+	int lt = left + 1, gt = right - 1;
+	{
+		SORT_TRACE_SCOPE("partition", right - left + 1);
+		for (int k = lt; k <= gt; ++k)
+		{
+			if (less_than(a[k], p))
+			{
+				std::swap(a[k], a[lt]);
+				++lt;
+			}
+			else if (less_than(q, a[k]))
+			{
+				while (less_than(q, a[gt]) && k < gt)
+					--gt;
+				std::swap(a[k], a[gt]);
+				--gt;
+				if (less_than(a[k], p))
+				{
+					std::swap(a[k], a[lt]);
+					++lt;
+				}
+			}
+		}
+	}
+
+	// Place pivots in correct positions
+	--lt;
+	++gt;
+	std::swap(a[left], a[lt]);
+	std::swap(a[right], a[gt]);
+
+	dualPivotQuicksort(a, less_than, left, lt - 1);		// Sort items below p
+	if (less_than(a[lt], a[gt]))						// Otherwise every middle item equals the pivots
+		dualPivotQuicksort(a, less_than, lt + 1, gt - 1);	// Sort items between p and q
+	dualPivotQuicksort(a, less_than, gt + 1, right);	// Sort items above q
+}
+
+/**
+ * Internal three-pivot quicksort method that makes recursive calls.
+ * Partitions around the 2nd, 4th and 6th items p, q, r of a sorted
+ * sample of 7, into items below p, between p and q, between q and r,
+ * and above r, scanning from both ends as in Hoare's partitioning.
+ * The pivots stay at the ends of the subarray while partitioning and
+ * are compared by reference.
+ * a is an array of Comparable items.
+ * left is the left-most index of the subarray.
+ * right is the right-most index of the subarray.
+ */
+template <typename Comparable, typename Comparator>
+void threePivotQuicksort(vector<Comparable>& a, Comparator less_than, int left, int right)
+{
+	SORT_TRACE_SCOPE("three pivot quicksort", right - left + 1);
+	int cutoff = sortProfile<Comparable>().insertionCutoff;
+	if (cutoff < MULTI_PIVOT_CUTOFF)
+		cutoff = MULTI_PIVOT_CUTOFF;
+
+	if (left + cutoff > right)
+	{
+		insertionSort(a, less_than, left, right);
+		return;
+	}
+
+	int pos[7];
+	sortPivotSample(a, less_than, left, right, pos, 7);
+	std::swap(a[left], a[pos[1]]);
+	std::swap(a[left + 1], a[pos[3]]);
+	std::swap(a[right], a[pos[5]]);
+	const Comparable& p = a[left];
+	const Comparable& q = a[left + 1];
+	const Comparable& r = a[right];
+
+	// a[left+2..i) < p, a[i..j) in [p, q], a(k..l] in [q, r], a(l..right-1] > r
+	int i = left + 2, j = left + 2, k = right - 1, l = right - 1;
+	{
+		SORT_TRACE_SCOPE("partition", right - left + 1);
+		while (j <= k)
+		{
+			while (j <= k && less_than(a[j], q))
+			{
+				if (less_than(a[j], p))
+				{
+					std::swap(a[i], a[j]);
+					++i;
+				}
+				++j;
+			}
+			while (j <= k && less_than(q, a[k]))
+			{
+				if (less_than(r, a[k]))
+				{
+					std::swap(a[k], a[l]);
+					--l;
+				}
+				--k;
+			}
+			if (j < k)
+			{
+				// a[j] is at least q and a[k] at most q; exchange them
+				std::swap(a[j], a[k]);
+				if (less_than(a[j], p))
+				{
+					std::swap(a[i], a[j]);
+					++i;
+				}
+				if (less_than(r, a[k]))
+				{
+					std::swap(a[k], a[l]);
+					--l;
+				}
+				++j;
+				--k;
+			}
+			else if (j == k)
+			{
+				++j;	// Equals q
+			}
+		}
+	}
+
+	// Place pivots in correct positions: q to the end of [p, q], then p and r next to their sides
+	std::swap(a[left + 1], a[i - 1]);
+	std::swap(a[i - 1], a[j - 1]);
+	std::swap(a[left], a[i - 2]);
+	std::swap(a[right], a[l + 1]);
+	int pi = i - 2, qi = j - 1, ri = l + 1;
+
+	threePivotQuicksort(a, less_than, left, pi - 1);			// Sort items below p
+	if (less_than(a[pi], a[qi]))
+		threePivotQuicksort(a, less_than, pi + 1, qi - 1);	// Sort items between p and q
+	if (less_than(a[qi], a[ri]))
+		threePivotQuicksort(a, less_than, qi + 1, ri - 1);	// Sort items between q and r
+	threePivotQuicksort(a, less_than, ri + 1, right);		// Sort items above r
+}
+
+/**
+ * Multi-pivot quicksort algorithm (driver).
+ * numPivots is 2 for dual-pivot or 3 for three-pivot partitioning.
+ */
+template <typename Comparable, typename Comparator>
+void multiPivotQuicksort(vector<Comparable>& a, Comparator less_than, int numPivots = 2)
+{
+	if (numPivots == 3)
+		threePivotQuicksort(a, less_than, 0, int(a.size()) - 1);
+	else
+		dualPivotQuicksort(a, less_than, 0, int(a.size()) - 1);
+}
+
+
 /**
  * Internal selection method that makes recursive calls.
- * Uses median-of-three partitioning and a cutoff of 10.
+ * Uses median-of-three partitioning and the insertion sort
+ * cutoff from the sort profile (10 by default).
  * Places the kth smallest item in a[k-1].
  * a is an array of Comparable items.
  * left is the left-most index of the subarray.
@@ -394,7 +728,7 @@ void quicksort(vector<Comparable>& a, Comparator less_than)
 template <typename Comparable>
 void quickSelect( vector<Comparable> & a, int left, int right, int k )
 {
-    if( left + 10 <= right )
+    if( left + sortProfile<Comparable>().insertionCutoff <= right )
     {
         const Comparable & pivot = median3( a, left, right );
 
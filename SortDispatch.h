@@ -0,0 +1,501 @@
+/*
+	This is the SortDispatch.h header file.
+	This file contains sort, a single entry point that looks at a cheap sample
+	of the input and picks the sorting routine expected to be fastest for it.
+
+	The choice is based on the size of the input, how presorted it is
+	(adjacent pairs in or out of order, from a sample), how many duplicates
+	it has (from a sorted sample), the size of one item, whether the items
+	are integers ordered by less or greater, and what the caller needs
+	(stability, a worst-case bound, threads):
+
+	  - sorted or strictly descending input costs one pass;
+	  - input made of a few long runs is merged from them (natural mergesort);
+	  - integer keys are radix sorted, in a few passes and no comparisons;
+	  - large items are sorted by index and then moved once each, instead of
+	    O(log n) times;
+	  - large inputs with several threads go to the sample sort;
+	  - input with many duplicates is partitioned three ways, so a run of
+	    equal items is finished by the partition that finds it.
+
+	sort returns the SortDecision it made, and SortDecision can be written
+	to a stream, so choices can be logged and audited.
+*/
+
+#ifndef SORT_DISPATCH_H
+#define SORT_DISPATCH_H
+
+#include "Sort.h"
+#include "SampleSort.h"
+#include <algorithm>
+#include <ostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+/**
+ * Number of adjacent pairs looked at to estimate presortedness, and of
+ * items looked at to estimate duplicates.
+ */
+const int DISPATCH_SAMPLE_SIZE = 256;
+
+/**
+ * Input whose runs hold at least this many items on average is merged from
+ * its runs. With shorter runs quicksort, which is fast on presorted input
+ * too, does better.
+ */
+const int DISPATCH_MIN_RUN = 4096;
+
+/**
+ * Integer keys are radix sorted from this many items on.
+ */
+const int DISPATCH_RADIX_CUTOFF = 1 << 10;
+
+/**
+ * Items larger than this many bytes are sorted by index. A stable sort
+ * (mergesort otherwise) moves its items more often, so it switches sooner.
+ */
+const size_t DISPATCH_LARGE_ITEM = 256;
+const size_t DISPATCH_LARGE_STABLE_ITEM = 32;
+
+/**
+ * Input where at least this fraction of the sampled items equal their sorted
+ * neighbour is sorted with the three-way quicksort.
+ */
+const double DISPATCH_MANY_DUPLICATES = 0.25;
+
+/**
+ * What the caller knows about, or needs from, a sort.
+ */
+struct SortHints
+{
+	bool stable = false;			// Equal items must keep their order
+	bool worstCaseBound = false;	// Needs O(n log n) time in the worst case and no extra memory
+	int numThreads = 1;				// Threads the sort may use
+};
+
+/**
+ * The sorting routines sort can dispatch to.
+ * Shellsort is not one of them, since it only sorts with operator<.
+ */
+enum class SortEngine
+{
+	AlreadySorted,	// Nothing to do
+	Reverse,		// Strictly descending; reversing sorts it
+	InsertionSort,
+	Quicksort,
+	MergeSort,
+	NaturalMergeSort,	// Merges the runs already in the input
+	RadixSort,			// Integer keys, ordered by less or greater
+	IndexSort,			// Large items: sorts indices, then moves each item once
+	Heapsort,
+	SampleSort,
+	ThreeWayQuicksort	// Many duplicates: items equal to the pivot are set aside by each partition
+};
+
+inline const char* sortEngineName(SortEngine engine)
+{
+	switch (engine)
+	{
+	case SortEngine::AlreadySorted:    return "already sorted";
+	case SortEngine::Reverse:          return "reverse";
+	case SortEngine::InsertionSort:    return "insertion sort";
+	case SortEngine::Quicksort:        return "quicksort";
+	case SortEngine::MergeSort:        return "mergesort";
+	case SortEngine::NaturalMergeSort: return "natural mergesort";
+	case SortEngine::RadixSort:        return "radix sort";
+	case SortEngine::IndexSort:        return "index sort";
+	case SortEngine::Heapsort:         return "heapsort";
+	case SortEngine::SampleSort:       return "sample sort";
+	case SortEngine::ThreeWayQuicksort: return "three-way quicksort";
+	}
+	return "unknown";
+}
+
+/**
+ * The routine chosen by sort, and the input characteristics it was chosen from.
+ */
+struct SortDecision
+{
+	SortEngine engine = SortEngine::Quicksort;
+	size_t size = 0;
+	double inOrder = 0;			// Fraction of sampled adjacent pairs already in order
+	double descending = 0;		// Fraction of sampled adjacent pairs strictly out of order
+	double duplicates = 0;		// Fraction of sampled items equal to their sorted neighbour
+	size_t elementSize = 0;
+	bool integralKey = false;	// Integer items ordered by less or greater, so radix sortable
+	bool stable = false;
+	bool worstCaseBound = false;
+	int numThreads = 1;
+	string reason;
+};
+
+inline ostream& operator<<(ostream& out, const SortDecision& d)
+{
+	return out << "engine=" << sortEngineName(d.engine) << " size=" << d.size
+		<< " inOrder=" << d.inOrder << " descending=" << d.descending
+		<< " duplicates=" << d.duplicates << " elementSize=" << d.elementSize
+		<< " integral=" << d.integralKey << " stable=" << d.stable
+		<< " worstCaseBound=" << d.worstCaseBound
+		<< " threads=" << d.numThreads << " reason=\"" << d.reason << "\"";
+}
+
+/**
+ * Internal method for sort.
+ * Returns the number of adjacent pairs of a out of order, or, when
+ * descending is true, the number not strictly out of order: one less than
+ * the number of ascending (descending) runs.
+ */
+template <typename Comparable, typename Comparator>
+int countRunBreaks(const vector<Comparable>& a, Comparator less_than, bool descending)
+{
+	int breaks = 0;
+	for (size_t i = 1; i < a.size(); ++i)
+		breaks += less_than(a[i], a[i - 1]) != descending;
+	return breaks;
+}
+
+/**
+ * Internal trait for sort.
+ * True when Comparable is an integer type (not bool) and Comparator is
+ * less or greater on it, so the order is the order of the key bits.
+ */
+template <typename Comparable, typename Comparator>
+struct isRadixSortable
+	: integral_constant<bool, is_integral<Comparable>::value && !is_same<Comparable, bool>::value &&
+		(is_same<Comparator, less<Comparable>>::value || is_same<Comparator, greater<Comparable>>::value)>
+{
+};
+
+/**
+ * Internal method for sort.
+ * LSD radix sort of integers, a byte at a time, in the order of Comparator
+ * (less or greater). Passes on a byte that every item shares are skipped.
+ * Stable, and makes no comparisons.
+ */
+template <typename Comparable, typename Comparator>
+void radixSort(vector<Comparable>& a, Comparator)
+{
+	typedef typename make_unsigned<Comparable>::type Key;
+	const bool descending = is_same<Comparator, greater<Comparable>>::value;
+	const Key signBit = is_signed<Comparable>::value ? Key(Key(1) << (8 * sizeof(Key) - 1)) : Key(0);
+	auto keyOf = [&](const Comparable& x)
+	{
+		Key key = Key(x) ^ signBit;
+		return descending ? Key(~key) : key;
+	};
+
+	SORT_TRACE_SCOPE("radix sort", a.size());
+	int n = a.size();
+	vector<Comparable> tmp(n);
+	for (size_t shift = 0; shift < 8 * sizeof(Key); shift += 8)
+	{
+		int count[257] = { 0 };
+		for (int i = 0; i < n; ++i)
+			++count[((keyOf(a[i]) >> shift) & 0xff) + 1];
+		if (count[((keyOf(a[0]) >> shift) & 0xff) + 1] == n)
+			continue;
+
+		for (int d = 0; d < 256; ++d)
+			count[d + 1] += count[d];
+		for (int i = 0; i < n; ++i)
+			tmp[count[(keyOf(a[i]) >> shift) & 0xff]++] = a[i];
+		a.swap(tmp);
+	}
+}
+
+/**
+ * Internal method for sort.
+ * Sorts a by index: sorts the indices of the items (with mergesort when
+ * stable, quicksort otherwise), then moves every item to its place
+ * once, following the cycles of the permutation.
+ */
+template <typename Comparable, typename Comparator>
+void indexSort(vector<Comparable>& a, Comparator less_than, bool stable)
+{
+	SORT_TRACE_SCOPE("index sort", a.size());
+	int n = a.size();
+	vector<int> index(n);
+	for (int i = 0; i < n; ++i)
+		index[i] = i;
+	auto indexLess = [&](int x, int y) { return less_than(a[x], a[y]); };
+	if (stable)
+		mergeSort(index, indexLess);
+	else
+		quicksort(index, indexLess);
+
+	// a[i] gets the item at a[index[i]]; index[i] = i marks a place that is done
+	for (int i = 0; i < n; ++i)
+	{
+		if (index[i] == i)
+			continue;
+		Comparable item = std::move(a[i]);
+		int j = i;
+		while (index[j] != i)
+		{
+			int next = index[j];
+			a[j] = std::move(a[next]);
+			index[j] = j;
+			j = next;
+		}
+		a[j] = std::move(item);
+		index[j] = j;
+	}
+}
+
+/**
+ * Internal method for sort.
+ * Natural mergesort: splits a into the runs it already has (strictly
+ * descending runs are reversed), then merges neighbouring runs pairwise
+ * until one is left. O(n log r) for r runs, and stable.
+ */
+template <typename Comparable, typename Comparator>
+void naturalMergeSort(vector<Comparable>& a, Comparator less_than)
+{
+	SORT_TRACE_SCOPE("natural mergesort", a.size());
+	int n = a.size();
+	vector<int> runStart;
+	for (int i = 0, j; i < n; i = j)
+	{
+		runStart.push_back(i);
+		j = i + 1;
+		if (j < n && less_than(a[j], a[i]))
+		{
+			while (j + 1 < n && less_than(a[j + 1], a[j]))
+				++j;
+			std::reverse(a.begin() + i, a.begin() + ++j);
+		}
+		else
+			while (j < n && !less_than(a[j], a[j - 1]))
+				++j;
+	}
+	runStart.push_back(n);
+
+	vector<Comparable> tmpArray(runStart.size() > 2 ? n : 0);
+	while (runStart.size() > 2)
+	{
+		vector<int> merged;
+		size_t r = 0;
+		for (; r + 2 < runStart.size(); r += 2)
+		{
+			merge(a, less_than, tmpArray, runStart[r], runStart[r + 1], runStart[r + 2] - 1);
+			merged.push_back(runStart[r]);
+		}
+		if (r + 1 < runStart.size())
+			merged.push_back(runStart[r]);		// An odd run out waits for the next round
+		merged.push_back(n);
+		runStart.swap(merged);
+	}
+}
+
+/**
+ * Internal method for sort.
+ * Quicksort that partitions a[left .. right] three ways (Dijkstra): less
+ * than, equal to and greater than the median of three, and recurses only
+ * into the first and last part. O(n log k) for k distinct items. Only
+ * swaps items; the pivot is always the item at a[lt].
+ */
+template <typename Comparable, typename Comparator>
+void threeWayQuicksort(vector<Comparable>& a, Comparator less_than, int left, int right)
+{
+	while (left + sortProfile<Comparable>().insertionCutoff <= right)
+	{
+		SORT_TRACE_SCOPE("three-way partition", right - left + 1);
+		median3(a, less_than, left, right);
+		std::swap(a[left], a[right - 1]);
+
+		// a[left .. lt - 1] < pivot, a[lt .. i - 1] == pivot, a[gt + 1 .. right] > pivot
+		int lt = left, i = left + 1, gt = right;
+		while (i <= gt)
+		{
+			if (less_than(a[i], a[lt]))
+				std::swap(a[lt++], a[i++]);
+			else if (less_than(a[lt], a[i]))
+				std::swap(a[i], a[gt--]);
+			else
+				++i;
+		}
+
+		// Recurse into the smaller part, loop on the larger one
+		if (lt - left < right - gt)
+		{
+			threeWayQuicksort(a, less_than, left, lt - 1);
+			left = gt + 1;
+		}
+		else
+		{
+			threeWayQuicksort(a, less_than, gt + 1, right);
+			right = lt - 1;
+		}
+	}
+	if (left < right)
+		insertionSort(a, less_than, left, right);
+}
+
+/**
+ * Looks at a sample of a and decides how sort would sort it.
+ * Only reads a; a full O(n) scan, counting the runs, is made only when
+ * the sample suggests a is sorted or strictly descending.
+ */
+template <typename Comparable, typename Comparator>
+SortDecision chooseSortEngine(const vector<Comparable>& a, Comparator less_than, const SortHints& hints = SortHints())
+{
+	SortDecision d;
+	d.size = a.size();
+	d.elementSize = sizeof(Comparable);
+	d.integralKey = isRadixSortable<Comparable, Comparator>::value;
+	d.stable = hints.stable;
+	d.worstCaseBound = hints.worstCaseBound;
+	d.numThreads = hints.numThreads;
+
+	if (a.size() < 2)
+	{
+		d.engine = SortEngine::AlreadySorted;
+		d.reason = "fewer than 2 items";
+		return d;
+	}
+
+	// Sample adjacent pairs for presortedness, and single items for duplicates
+	int n = a.size();
+	int samples = std::min(n - 1, DISPATCH_SAMPLE_SIZE);
+	minstd_rand random(n);
+	int inOrder = 0, descending = 0;
+	vector<int> sample;
+	sample.reserve(samples);
+	for (int s = 0; s < samples; ++s)
+	{
+		int i = samples == n - 1 ? s : int(random() % (n - 1));
+		if (!less_than(a[i + 1], a[i]))
+			++inOrder;
+		else
+			++descending;
+		sample.push_back(i);
+	}
+	d.inOrder = double(inOrder) / samples;
+	d.descending = double(descending) / samples;
+
+	auto itemLess = [&](int x, int y) { return less_than(a[x], a[y]); };
+	quicksort(sample, itemLess);
+	int equal = 0;
+	for (size_t i = 1; i < sample.size(); ++i)
+		equal += !itemLess(sample[i - 1], sample[i]);
+	d.duplicates = double(equal) / samples;
+
+	// Count the runs with one full pass when the sample shows no break between them
+	int runBreaks = inOrder == samples || descending == samples ? countRunBreaks(a, less_than, inOrder < samples) : n;
+	if (runBreaks == 0)
+	{
+		d.engine = inOrder == samples ? SortEngine::AlreadySorted : SortEngine::Reverse;
+		d.reason = inOrder == samples ? "input is already sorted" : "input is strictly descending";
+	}
+	else if (n <= 16)
+	{
+		d.engine = SortEngine::InsertionSort;
+		d.reason = "tiny input";
+	}
+	else if (hints.worstCaseBound && !hints.stable)
+	{
+		d.engine = SortEngine::Heapsort;
+		d.reason = "worst-case O(n log n) bound without extra memory required";
+	}
+	else if (runBreaks < n / DISPATCH_MIN_RUN)
+	{
+		d.engine = SortEngine::NaturalMergeSort;
+		d.reason = "nearly sorted; merging its few long runs takes few passes";
+	}
+	else if (d.integralKey && n >= DISPATCH_RADIX_CUTOFF)
+	{
+		d.engine = SortEngine::RadixSort;
+		d.reason = "integral keys; a radix pass per key byte, no comparisons";
+	}
+	else if (d.elementSize > (hints.stable ? DISPATCH_LARGE_STABLE_ITEM : DISPATCH_LARGE_ITEM))
+	{
+		d.engine = SortEngine::IndexSort;
+		d.reason = "large items; sorting indices moves each item only once";
+	}
+	else if (hints.stable)
+	{
+		d.engine = SortEngine::MergeSort;
+		d.reason = "stable sort required";
+	}
+	else if (hints.numThreads > 1 && n >= SAMPLE_SORT_CUTOFF)
+	{
+		d.engine = SortEngine::SampleSort;
+		d.reason = "large input and several threads";
+	}
+	else if (d.duplicates >= DISPATCH_MANY_DUPLICATES)
+	{
+		d.engine = SortEngine::ThreeWayQuicksort;
+		d.reason = "many duplicates; each partition sets aside the items equal to its pivot";
+	}
+	else
+	{
+		d.engine = SortEngine::Quicksort;
+		d.reason = "general case";
+	}
+
+	return d;
+}
+
+/**
+ * Runs the routine chosen in d on a.
+ */
+template <typename Comparable, typename Comparator>
+void runSortEngine(vector<Comparable>& a, Comparator less_than, const SortDecision& d)
+{
+	switch (d.engine)
+	{
+	case SortEngine::AlreadySorted:
+		break;
+	case SortEngine::Reverse:
+		std::reverse(a.begin(), a.end());
+		break;
+	case SortEngine::InsertionSort:
+		insertionSort(a, less_than, 0, int(a.size()) - 1);
+		break;
+	case SortEngine::Quicksort:
+		quicksort(a, less_than);
+		break;
+	case SortEngine::MergeSort:
+		mergeSort(a, less_than);
+		break;
+	case SortEngine::NaturalMergeSort:
+		naturalMergeSort(a, less_than);
+		break;
+	case SortEngine::RadixSort:
+		if constexpr (isRadixSortable<Comparable, Comparator>::value)
+			radixSort(a, less_than);
+		else
+			quicksort(a, less_than);	// Not chosen for these types
+		break;
+	case SortEngine::IndexSort:
+		indexSort(a, less_than, d.stable);
+		break;
+	case SortEngine::Heapsort:
+		heapsort(a, less_than);
+		break;
+	case SortEngine::SampleSort:
+		sampleSort(a, less_than, d.numThreads);
+		break;
+	case SortEngine::ThreeWayQuicksort:
+		threeWayQuicksort(a, less_than, 0, int(a.size()) - 1);
+		break;
+	}
+}
+
+/**
+ * Adaptive sort.
+ * Samples a, picks the sorting routine expected to be fastest, and runs it.
+ * Returns the decision, for logging.
+ */
+template <typename Comparable, typename Comparator>
+SortDecision sort(vector<Comparable>& a, Comparator less_than, const SortHints& hints = SortHints())
+{
+	SortDecision d = chooseSortEngine(a, less_than, hints);
+	runSortEngine(a, less_than, d);
+	return d;
+}
+
+#endif
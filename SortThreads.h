@@ -0,0 +1,30 @@
+/*
+	This is the SortThreads.h header file.
+	This file contains runOnThreads, which the parallel routines (sample
+	sort, semisort, the parallel order check) use to split their work
+	across threads.
+*/
+
+#ifndef SORT_THREADS_H
+#define SORT_THREADS_H
+
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * Runs work(t) for t = 0 .. numThreads - 1, each on its own thread,
+ * and returns when all of them are done. The calling thread runs work(0).
+ */
+template <typename Work>
+void runOnThreads(int numThreads, Work work)
+{
+	vector<thread> workers;
+	for (int t = 1; t < numThreads; ++t)
+		workers.emplace_back(work, t);
+	work(0);
+	for (auto& w : workers)
+		w.join();
+}
+
+#endif
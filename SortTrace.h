@@ -0,0 +1,352 @@
+/*
+	This is the SortTrace.h header file.
+	This file contains the optional tracing layer of the sorting routines,
+	which records where a sort spends its time and exports it as a Chrome
+	trace (JSON) that can be opened in Perfetto or chrome://tracing.
+
+	Tracing is compiled in only when SORT_TRACE is defined ("make TRACE=1").
+	Otherwise SORT_TRACE_SCOPE expands to nothing and costs nothing.
+
+	The sorting routines mark their phases (partition, median3, insertion
+	sort, merge, heap build and extract, sample sort phases, pool tasks)
+	with SORT_TRACE_SCOPE. Each scope records one event with its start,
+	duration, nesting depth, range size and thread. Every thread writes to
+	its own buffer without locking. A buffer starts small and grows as
+	events come in, up to SORT_TRACE_CAPACITY events; past that it is a
+	ring that overwrites its oldest events. When a thread ends, its events
+	are copied to a shared ring of SORT_TRACE_RETIRED_CAPACITY events and
+	its buffer is freed, so threads that come and go (sample sort, semisort)
+	do not pile up buffers. Ranges smaller than the minimum size (the
+	SORT_TRACE_MIN_SIZE environment variable, or setSortTraceMinSize) are
+	not recorded, which keeps the trace of a large sort from being flooded
+	by its base cases.
+
+	writeSortTrace and clearSortTrace read or reset every thread's buffer,
+	so they must be called while no sort is running.
+*/
+
+#ifndef SORT_TRACE_H
+#define SORT_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * Number of events each thread keeps at most.
+ */
+#ifndef SORT_TRACE_CAPACITY
+#define SORT_TRACE_CAPACITY (1 << 20)
+#endif
+
+/**
+ * Number of events room is made for when a thread first traces.
+ */
+#ifndef SORT_TRACE_INITIAL_CAPACITY
+#define SORT_TRACE_INITIAL_CAPACITY 1024
+#endif
+
+/**
+ * Number of events kept, in total, of the threads that have ended.
+ */
+#ifndef SORT_TRACE_RETIRED_CAPACITY
+#define SORT_TRACE_RETIRED_CAPACITY (1 << 20)
+#endif
+
+/**
+ * One recorded scope.
+ */
+struct TraceEvent
+{
+	const char* name;
+	long long begin;	// Nanoseconds since the first traced event of the program
+	long long duration;	// Nanoseconds
+	int depth;			// Number of enclosing scopes on the same thread
+	int size;			// Number of items in the range the scope worked on
+};
+
+/**
+ * Events recorded by one running thread.
+ * Only the owning thread writes; written is published with release
+ * ordering so a reader sees complete events.
+ * Event w is at events[w % SORT_TRACE_CAPACITY]; events grows until it
+ * holds SORT_TRACE_CAPACITY of them.
+ */
+struct TraceBuffer
+{
+	explicit TraceBuffer(int tid) : tid(tid)
+	{
+		events.reserve(SORT_TRACE_INITIAL_CAPACITY);
+	}
+
+	void record(const TraceEvent& e)
+	{
+		unsigned long long w = written.load(memory_order_relaxed);
+		size_t slot = w % SORT_TRACE_CAPACITY;
+		if (slot < events.size())
+			events[slot] = e;
+		else
+			events.push_back(e);
+		written.store(w + 1, memory_order_release);
+	}
+
+	int tid;
+	int depth = 0;
+	vector<TraceEvent> events;
+	atomic<unsigned long long> written{ 0 };
+};
+
+/**
+ * An event of a thread that has ended.
+ */
+struct RetiredTraceEvent
+{
+	int tid;
+	TraceEvent event;
+};
+
+/**
+ * The buffers of the running threads that have traced, and a ring of the
+ * events of the threads that have ended (event w at retired[w % SORT_TRACE_RETIRED_CAPACITY]).
+ */
+struct TraceStore
+{
+	vector<shared_ptr<TraceBuffer>> buffers;
+	vector<RetiredTraceEvent> retired;
+	unsigned long long retiredWritten = 0;
+	int threads = 0;	// Threads that have traced, for numbering them
+};
+
+/**
+ * Internal method that returns the store of every thread's events, locked by guard.
+ * The store and its lock are never destroyed: threads of a static pool
+ * (sharedSortThreadPool) may end after the other statics are gone, and
+ * still retire their buffers into it.
+ */
+inline TraceStore& traceStore(unique_lock<mutex>& guard)
+{
+	static mutex& lock = *new mutex;
+	static TraceStore& store = *new TraceStore;
+	guard = unique_lock<mutex>(lock);
+	return store;
+}
+
+/**
+ * Internal method that moves the events of a thread that is ending into
+ * the retired ring, and drops its buffer.
+ */
+inline void retireTraceBuffer(const shared_ptr<TraceBuffer>& buffer)
+{
+	unique_lock<mutex> guard;
+	TraceStore& store = traceStore(guard);
+
+	unsigned long long written = buffer->written.load(memory_order_acquire);
+	unsigned long long start = written > SORT_TRACE_CAPACITY ? written - SORT_TRACE_CAPACITY : 0;
+	for (unsigned long long w = start; w < written; ++w)
+	{
+		RetiredTraceEvent e{ buffer->tid, buffer->events[w % SORT_TRACE_CAPACITY] };
+		size_t slot = store.retiredWritten++ % SORT_TRACE_RETIRED_CAPACITY;
+		if (slot < store.retired.size())
+			store.retired[slot] = e;
+		else
+			store.retired.push_back(e);
+	}
+
+	for (size_t b = 0; b < store.buffers.size(); ++b)
+		if (store.buffers[b] == buffer)
+		{
+			store.buffers.erase(store.buffers.begin() + b);
+			break;
+		}
+}
+
+/**
+ * Internal holder of a thread's buffer, which retires it when the thread ends.
+ */
+struct ThreadTraceBuffer
+{
+	shared_ptr<TraceBuffer> buffer;
+
+	~ThreadTraceBuffer()
+	{
+		if (buffer)
+			retireTraceBuffer(buffer);
+	}
+};
+
+/**
+ * Internal method that returns the calling thread's buffer.
+ * Only the first call on each thread takes a lock, to register it.
+ */
+inline TraceBuffer& threadTraceBuffer()
+{
+	thread_local ThreadTraceBuffer holder;
+	if (!holder.buffer)
+	{
+		unique_lock<mutex> guard;
+		TraceStore& store = traceStore(guard);
+		holder.buffer = make_shared<TraceBuffer>(++store.threads);
+		store.buffers.push_back(holder.buffer);
+	}
+	return *holder.buffer;
+}
+
+/**
+ * Internal method that returns nanoseconds since the first call.
+ */
+inline long long traceClock()
+{
+	static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+/**
+ * Internal method that returns the smallest range size that is recorded,
+ * initially the SORT_TRACE_MIN_SIZE environment variable, or 0.
+ */
+inline atomic<int>& sortTraceMinSize()
+{
+	static atomic<int> minSize{ getenv("SORT_TRACE_MIN_SIZE") != nullptr ? atoi(getenv("SORT_TRACE_MIN_SIZE")) : 0 };
+	return minSize;
+}
+
+/**
+ * Ranges of fewer than minSize items are not recorded from now on.
+ */
+inline void setSortTraceMinSize(int minSize)
+{
+	sortTraceMinSize().store(minSize, memory_order_relaxed);
+}
+
+/**
+ * Records the time from its construction to its destruction as one event
+ * on the calling thread. Use it through SORT_TRACE_SCOPE.
+ */
+class TraceScope
+{
+public:
+	TraceScope(const char* name, int size)
+		: name(name), size(size), buffer(nullptr), begin(0)
+	{
+		if (size < sortTraceMinSize().load(memory_order_relaxed))
+			return;
+		buffer = &threadTraceBuffer();
+		++buffer->depth;
+		begin = traceClock();
+	}
+
+	~TraceScope()
+	{
+		if (buffer == nullptr)
+			return;
+		long long end = traceClock();
+		--buffer->depth;
+		buffer->record(TraceEvent{ name, begin, end - begin, buffer->depth, size });
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* name;
+	int size;
+	TraceBuffer* buffer;
+	long long begin;
+};
+
+#define SORT_TRACE_CONCAT_(a, b) a##b
+#define SORT_TRACE_CONCAT(a, b) SORT_TRACE_CONCAT_(a, b)
+
+/**
+ * Records the rest of the enclosing block as an event called name
+ * (a string literal) on a range of size items.
+ */
+#ifdef SORT_TRACE
+#define SORT_TRACE_SCOPE(name, size) TraceScope SORT_TRACE_CONCAT(sortTraceScope, __LINE__)(name, int(size))
+#else
+#define SORT_TRACE_SCOPE(name, size) ((void)0)
+#endif
+
+/**
+ * Internal method that writes ns nanoseconds as microseconds with three decimals.
+ */
+inline void writeTraceMicros(ostream& out, long long ns)
+{
+	out << ns / 1000 << "." << ns / 100 % 10 << ns / 10 % 10 << ns % 10;
+}
+
+/**
+ * Internal method that writes one event of thread tid to out.
+ */
+inline void writeTraceEvent(ostream& out, int tid, const TraceEvent& e, bool& first)
+{
+	out << (first ? "\n" : ",\n");
+	first = false;
+	out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":";
+	writeTraceMicros(out, e.begin);
+	out << ",\"dur\":";
+	writeTraceMicros(out, e.duration);
+	out << ",\"args\":{\"depth\":" << e.depth << ",\"size\":" << e.size << "}}";
+}
+
+/**
+ * Writes every recorded event to out as a Chrome trace (JSON object format),
+ * those of the threads that have ended first.
+ * Timestamps are in microseconds; depth and size are in each event's args.
+ */
+inline void writeSortTrace(ostream& out)
+{
+	unique_lock<mutex> guard;
+	TraceStore& store = traceStore(guard);
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	unsigned long long start = store.retiredWritten > SORT_TRACE_RETIRED_CAPACITY ?
+		store.retiredWritten - SORT_TRACE_RETIRED_CAPACITY : 0;
+	for (unsigned long long w = start; w < store.retiredWritten; ++w)
+	{
+		const RetiredTraceEvent& e = store.retired[w % SORT_TRACE_RETIRED_CAPACITY];
+		writeTraceEvent(out, e.tid, e.event, first);
+	}
+	for (auto& buffer : store.buffers)
+	{
+		unsigned long long written = buffer->written.load(memory_order_acquire);
+		start = written > SORT_TRACE_CAPACITY ? written - SORT_TRACE_CAPACITY : 0;
+		for (unsigned long long w = start; w < written; ++w)
+			writeTraceEvent(out, buffer->tid, buffer->events[w % SORT_TRACE_CAPACITY], first);
+	}
+	out << "\n]}\n";
+}
+
+/**
+ * Writes every recorded event to the file at path as a Chrome trace.
+ * Returns false if the file cannot be written.
+ */
+inline bool writeSortTrace(const string& path)
+{
+	ofstream out(path);
+	writeSortTrace(out);
+	return bool(out);
+}
+
+/**
+ * Forgets every recorded event, and frees the events of the threads that have ended.
+ */
+inline void clearSortTrace()
+{
+	unique_lock<mutex> guard;
+	TraceStore& store = traceStore(guard);
+	for (auto& buffer : store.buffers)
+		buffer->written.store(0, memory_order_release);
+	vector<RetiredTraceEvent>().swap(store.retired);
+	store.retiredWritten = 0;
+}
+
+#endif
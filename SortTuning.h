@@ -0,0 +1,159 @@
+/*
+	This is the SortTuning.h header file.
+	This file contains the tunable cutoffs and thresholds of the sorting
+	routines, and the code that loads them from a profile file.
+
+	A profile holds, for each element type, the values that were fastest on
+	this machine when measured by the tune_sort program ("make calibrate").
+	It is read the first time a sort needs it, from the file named by the
+	SORT_PROFILE environment variable, or from sort_profile.txt in the
+	current directory. Types that are not in the file, or a missing file,
+	use the compiled-in defaults.
+
+	So the first quicksort, heapsort, mergeSort or quickSelect of a program
+	opens and parses the file, and the first one of each element type takes
+	a lock. Programs that time sorts call loadSortProfiles with the types
+	they sort before they start timing.
+
+	Each line of the file is
+		<type> <insertion_cutoff> <merge_block> <heap_arity> <parallel_grain>
+	and lines starting with # are comments.
+*/
+
+#ifndef SORT_TUNING_H
+#define SORT_TUNING_H
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+using namespace std;
+
+/**
+ * Tunable values for one element type.
+ */
+struct SortProfile
+{
+	int insertionCutoff = 10;	// quicksort and quickSelect insertion sort subarrays of at most this many items; at least 2
+	int mergeBlock = 1;			// mergeSort insertion sorts subarrays of at most this many items
+	int heapArity = 2;			// Children per node in heapsort's heap
+	int parallelGrain = 8192;	// Fewest items given to each thread of a parallel sort
+};
+
+/**
+ * Name of an element type in the profile file.
+ */
+template <typename Comparable>
+struct SortTypeName { static const char* name() { return "default"; } };
+
+template <> struct SortTypeName<int> { static const char* name() { return "int32"; } };
+template <> struct SortTypeName<unsigned int> { static const char* name() { return "uint32"; } };
+template <> struct SortTypeName<long> { static const char* name() { return sizeof(long) == 8 ? "int64" : "int32"; } };
+template <> struct SortTypeName<long long> { static const char* name() { return "int64"; } };
+template <> struct SortTypeName<float> { static const char* name() { return "float"; } };
+template <> struct SortTypeName<double> { static const char* name() { return "double"; } };
+template <> struct SortTypeName<string> { static const char* name() { return "string"; } };
+
+/**
+ * Returns the path of the profile file.
+ */
+inline string sortProfilePath()
+{
+	const char* path = getenv("SORT_PROFILE");
+	return path != nullptr && *path != '\0' ? path : "sort_profile.txt";
+}
+
+/**
+ * Internal method that reads the profile file at path into profiles.
+ * Ignores lines it cannot parse. Returns false if the file cannot be opened.
+ */
+inline bool readSortProfiles(const string& path, map<string, SortProfile>& profiles)
+{
+	ifstream in(path);
+	if (!in)
+		return false;
+
+	string line;
+	while (getline(in, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		istringstream fields(line);
+		string type;
+		SortProfile p;
+		if (fields >> type >> p.insertionCutoff >> p.mergeBlock >> p.heapArity >> p.parallelGrain &&
+			p.insertionCutoff >= 2 && p.mergeBlock >= 1 && p.heapArity >= 2 && p.parallelGrain >= 1)
+			profiles[type] = p;
+	}
+	return true;
+}
+
+/**
+ * Internal method that returns the profile for type name, loading the
+ * profile file on the first call. Falls back to the "default" line of
+ * the file, then to the compiled-in defaults.
+ * The returned reference stays valid for the whole program.
+ */
+inline SortProfile& sortProfileFor(const string& name)
+{
+	static mutex lock;
+	static map<string, SortProfile> profiles;
+	static bool loaded = false;
+
+	lock_guard<mutex> guard(lock);
+	if (!loaded)
+	{
+		readSortProfiles(sortProfilePath(), profiles);
+		loaded = true;
+	}
+
+	auto found = profiles.find(name);
+	if (found != profiles.end())
+		return found->second;
+
+	auto fallback = profiles.find("default");
+	return profiles[name] = fallback != profiles.end() ? fallback->second : SortProfile();
+}
+
+/**
+ * Returns the profile for the element type Comparable.
+ * Only the first call for each type takes a lock, and the first call of
+ * the program reads the profile file.
+ * Changes made through the reference are seen by later sorts of that type.
+ */
+template <typename Comparable>
+SortProfile& sortProfile()
+{
+	static SortProfile& profile = sortProfileFor(SortTypeName<Comparable>::name());
+	return profile;
+}
+
+/**
+ * Reads the profile file and looks up the profiles of Comparables, so that
+ * no later sort of those types reads the file or takes a lock.
+ */
+template <typename... Comparables>
+void loadSortProfiles()
+{
+	(sortProfile<Comparables>(), ...);
+}
+
+/**
+ * Writes profiles to path in the profile file format.
+ * Returns false if the file cannot be written.
+ */
+inline bool writeSortProfiles(const string& path, const map<string, SortProfile>& profiles)
+{
+	ofstream out(path);
+	out << "# Sort profile written by tune_sort" << endl;
+	out << "# type insertion_cutoff merge_block heap_arity parallel_grain" << endl;
+	for (auto& entry : profiles)
+		out << entry.first << " " << entry.second.insertionCutoff << " " << entry.second.mergeBlock << " "
+			<< entry.second.heapArity << " " << entry.second.parallelGrain << endl;
+	return bool(out);
+}
+
+#endif
@@ -0,0 +1,274 @@
+/*
+	This is the SortVerify.h header file.
+	This file contains the checks the drivers run on the output of a sort:
+	isSortedParallel (is it in order), multisetChecksum (is it a permutation
+	of the input) and isStable (are equal items still in input order).
+
+	All three look at each item once and split the vector between threads,
+	so they stay cheap next to the sort even for a billion items. The order
+	check of int and double vectors compares four or two neighbours at a
+	time with SSE2; other types use a loop without a branch per item.
+
+	multisetChecksum does not depend on the order of the items. Comparing
+	the checksum taken before the sort with the one taken after finds items
+	that were lost, duplicated or overwritten, which an order check alone
+	misses (a vector of copies of one item is always in order).
+*/
+
+#ifndef SORT_VERIFY_H
+#define SORT_VERIFY_H
+
+#include "Sort.h"
+#include "SortThreads.h"
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+/**
+ * Number of items checked between looks at whether another thread already failed.
+ */
+const int VERIFY_BLOCK = 4096;
+
+/**
+ * Vectors smaller than this are checked on the calling thread.
+ */
+const int VERIFY_PARALLEL_CUTOFF = 1 << 16;
+
+/**
+ * Internal method that returns how many threads check a vector of n items,
+ * given the number asked for (0 for one per core).
+ */
+inline int verifyThreads(int n, int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = thread::hardware_concurrency();
+	if (numThreads < 1 || n < VERIFY_PARALLEL_CUTOFF)
+		return 1;
+	return numThreads;
+}
+
+/**
+ * Internal method that runs check(i, end) over blocks [i, end) of 0 .. n - 1
+ * on numThreads threads, and returns true if every call returned true.
+ * Stops early once a call returns false.
+ */
+template <typename Check>
+bool checkBlocks(int n, int numThreads, Check check)
+{
+	numThreads = verifyThreads(n, numThreads);
+	atomic<bool> ok{ true };
+	runOnThreads(numThreads, [&](int t)
+	{
+		int first = int((long long)n * t / numThreads);
+		int last = int((long long)n * (t + 1) / numThreads);
+		for (int i = first; i < last && ok.load(memory_order_relaxed); i += VERIFY_BLOCK)
+			if (!check(i, i + VERIFY_BLOCK < last ? i + VERIFY_BLOCK : last))
+				ok.store(false, memory_order_relaxed);
+	});
+	return ok.load();
+}
+
+/**
+ * Internal method for isSortedParallel.
+ * Returns true if no item of a[0..n-1] goes before the one ahead of it.
+ */
+template <typename Comparable, typename Comparator>
+bool inOrderBlock(const Comparable* a, int n, Comparator less_than)
+{
+	bool bad = false;
+	for (int i = 0; i + 1 < n; ++i)
+		bad |= less_than(a[i + 1], a[i]);
+	return !bad;
+}
+
+#ifdef __SSE2__
+/**
+ * Internal methods for isSortedParallel.
+ * Compare a[i..i+3] with a[i+1..i+4] (ints) or a[i..i+1] with a[i+1..i+2]
+ * (doubles) at once. Descending checks with the comparison reversed.
+ */
+template <bool Descending>
+bool inOrderInts(const int* a, int n)
+{
+	__m128i bad = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 4 < n; i += 4)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 1));
+		bad = _mm_or_si128(bad, Descending ? _mm_cmpgt_epi32(y, x) : _mm_cmplt_epi32(y, x));
+	}
+	bool tail = false;
+	for (; i + 1 < n; ++i)
+		tail |= Descending ? a[i] < a[i + 1] : a[i + 1] < a[i];
+	return _mm_movemask_epi8(bad) == 0 && !tail;
+}
+
+template <bool Descending>
+bool inOrderDoubles(const double* a, int n)
+{
+	__m128d bad = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 2 < n; i += 2)
+	{
+		__m128d x = _mm_loadu_pd(a + i);
+		__m128d y = _mm_loadu_pd(a + i + 1);
+		bad = _mm_or_pd(bad, Descending ? _mm_cmpgt_pd(y, x) : _mm_cmplt_pd(y, x));
+	}
+	bool tail = false;
+	for (; i + 1 < n; ++i)
+		tail |= Descending ? a[i] < a[i + 1] : a[i + 1] < a[i];
+	return _mm_movemask_pd(bad) == 0 && !tail;
+}
+
+inline bool inOrderBlock(const int* a, int n, less<int>) { return inOrderInts<false>(a, n); }
+inline bool inOrderBlock(const int* a, int n, greater<int>) { return inOrderInts<true>(a, n); }
+inline bool inOrderBlock(const double* a, int n, less<double>) { return inOrderDoubles<false>(a, n); }
+inline bool inOrderBlock(const double* a, int n, greater<double>) { return inOrderDoubles<true>(a, n); }
+#endif
+
+/**
+ * Returns true if a is sorted by less_than.
+ * numThreads is the number of threads to check with (0 for one per core).
+ */
+template <typename Comparable, typename Comparator>
+bool isSortedParallel(const vector<Comparable>& a, Comparator less_than, int numThreads = 0)
+{
+	int n = a.size();
+
+	// Each block also reads the first item of the next one, so no pair is skipped
+	return checkBlocks(n, numThreads, [&](int i, int end)
+	{
+		return inOrderBlock(a.data() + i, (end < n ? end + 1 : n) - i, less_than);
+	});
+}
+
+/**
+ * Order-independent summary of the items of a vector.
+ * Two vectors that hold the same items, in any order, have equal checksums;
+ * losing, duplicating or changing an item changes the checksum.
+ */
+struct MultisetChecksum
+{
+	long long count = 0;
+	unsigned long long sum1 = 0;	// Sums of two independent mixes of each item's hash
+	unsigned long long sum2 = 0;
+
+	MultisetChecksum& operator+=(const MultisetChecksum& other)
+	{
+		count += other.count;
+		sum1 += other.sum1;
+		sum2 += other.sum2;
+		return *this;
+	}
+
+	bool operator==(const MultisetChecksum& other) const
+	{
+		return count == other.count && sum1 == other.sum1 && sum2 == other.sum2;
+	}
+
+	bool operator!=(const MultisetChecksum& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+/**
+ * Default hash of multisetChecksum (and of semisort's keys): the value of
+ * integers, the bits of floating point numbers, and std::hash of everything
+ * else. -0.0 hashes as 0.0, since the two compare equal.
+ * Give multisetChecksum a hasher of your own for types std::hash does not know.
+ */
+struct ItemHash
+{
+	template <typename Comparable>
+	unsigned long long operator()(const Comparable& x) const
+	{
+		if constexpr (is_integral<Comparable>::value)
+			return (unsigned long long)x;
+		else if constexpr (is_floating_point<Comparable>::value && sizeof(Comparable) <= 8)
+		{
+			const Comparable y = x == 0 ? Comparable(0) : x;
+			unsigned long long bits = 0;
+			memcpy(&bits, &y, sizeof(Comparable));
+			return bits;
+		}
+		else
+			return hash<Comparable>{}(x);
+	}
+};
+
+/**
+ * Internal method for multisetChecksum (the splitmix64 finalizer).
+ * Spreads every bit of x over the whole result.
+ */
+inline unsigned long long mixItemHash(unsigned long long x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+ * Returns the checksum of the items of a.
+ * hasher maps an item to 64 bits; items that are equal must hash the same.
+ * numThreads is the number of threads to sum with (0 for one per core).
+ */
+template <typename Comparable, typename Hasher = ItemHash>
+MultisetChecksum multisetChecksum(const vector<Comparable>& a, Hasher hasher = Hasher(), int numThreads = 0)
+{
+	int n = a.size();
+	numThreads = verifyThreads(n, numThreads);
+	vector<MultisetChecksum> partial(numThreads);
+
+	runOnThreads(numThreads, [&](int t)
+	{
+		int first = int((long long)n * t / numThreads);
+		int last = int((long long)n * (t + 1) / numThreads);
+		MultisetChecksum sums;
+		for (int i = first; i < last; ++i)
+		{
+			unsigned long long h = hasher(a[i]);
+			sums.sum1 += mixItemHash(h);
+			sums.sum2 += mixItemHash(h ^ 0x9e3779b97f4a7c15ULL);
+		}
+		sums.count = last - first;
+		partial[t] = sums;
+	});
+
+	MultisetChecksum total;
+	for (const MultisetChecksum& sums : partial)
+		total += sums;
+	return total;
+}
+
+/**
+ * Returns true if the sorted vector a keeps equal items in input order.
+ * position(x) returns the index x had in the input (or anything that
+ * increases with it), so the items must carry their input order.
+ * numThreads is the number of threads to check with (0 for one per core).
+ */
+template <typename Comparable, typename Comparator, typename Position>
+bool isStable(const vector<Comparable>& a, Comparator less_than, Position position, int numThreads = 0)
+{
+	int n = a.size();
+	return checkBlocks(n, numThreads, [&](int i, int end)
+	{
+		bool bad = false;
+		for (int j = i; j < end && j + 1 < n; ++j)
+			bad |= !less_than(a[j], a[j + 1]) && position(a[j + 1]) < position(a[j]);
+		return !bad;
+	});
+}
+
+#endif
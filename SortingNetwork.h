@@ -0,0 +1,251 @@
+/*
+	This is the SortingNetwork.h header file.
+	This file contains the batched sorting routines used to sort many small,
+	independent groups stored back to back in one flat vector.
+
+	Groups of up to MAX_NETWORK_SIZE items are sorted with a sorting network
+	that is generated at compile time for each group size. Every network is
+	a fixed sequence of branchless compare-exchange steps, so no loop or
+	branch overhead is paid per group. Larger groups fall back to quicksort
+	from Sort.h.
+*/
+
+#ifndef SORTING_NETWORK_H
+#define SORTING_NETWORK_H
+
+#include "Sort.h"
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/**
+ * Largest group size that is sorted with a sorting network.
+ */
+const int MAX_NETWORK_SIZE = 32;
+
+/**
+ * One compare-exchange step of a sorting network.
+ * After the step the item at first is not larger than the item at second.
+ */
+struct NetworkPair
+{
+	int first;
+	int second;
+};
+
+/**
+ * Internal method for the sorting networks.
+ * Walks Batcher's merge exchange network for n items and, if pairs is not
+ * null, stores every compare-exchange step in it.
+ * Returns the number of compare-exchange steps in the network.
+ */
+constexpr int buildMergeExchange(int n, NetworkPair* pairs)
+{
+	if (n < 2)
+		return 0;
+
+	int t = 0;
+	while ((1 << t) < n)
+		++t;
+
+	int count = 0;
+	for (int p = 1 << (t - 1); p > 0; p >>= 1)
+	{
+		int q = 1 << (t - 1), r = 0, d = p;
+		while (d > 0)
+		{
+			for (int i = 0; i < n - d; ++i)
+				if ((i & p) == r)
+				{
+					if (pairs != nullptr)
+						pairs[count] = NetworkPair{ i, i + d };
+					++count;
+				}
+			d = q - p;
+			q >>= 1;
+			r = p;
+		}
+	}
+	return count;
+}
+
+/**
+ * The sorting network for N items, built at compile time.
+ */
+template <int N>
+struct SortingNetwork
+{
+	static constexpr int length = buildMergeExchange(N, nullptr);
+
+	struct Steps
+	{
+		NetworkPair step[length > 0 ? length : 1];
+	};
+
+	static constexpr Steps build()
+	{
+		Steps s{};
+		buildMergeExchange(N, s.step);
+		return s;
+	}
+
+	static constexpr Steps steps = build();
+};
+
+/**
+ * Branchless compare-exchange.
+ * Leaves the minimum of x and y in x and the maximum in y.
+ */
+template <typename Comparable, typename Comparator>
+inline void compareExchange(Comparable& x, Comparable& y, Comparator less_than)
+{
+	const bool swapped = less_than(y, x);
+	Comparable lo = std::move(swapped ? y : x);
+	Comparable hi = std::move(swapped ? x : y);
+	x = std::move(lo);
+	y = std::move(hi);
+}
+
+/**
+ * Internal method that expands every step of the network for N items
+ * into a straight line of compare-exchanges.
+ */
+template <int N, typename Comparable, typename Comparator, size_t... K>
+inline void applyNetwork(Comparable* a, Comparator less_than, index_sequence<K...>)
+{
+	(void)a;
+	(void)less_than;
+	(compareExchange(a[SortingNetwork<N>::steps.step[K].first],
+		a[SortingNetwork<N>::steps.step[K].second], less_than), ...);
+}
+
+/**
+ * Sorts the N items starting at a with the sorting network for N items.
+ */
+template <int N, typename Comparable, typename Comparator>
+void networkSort(Comparable* a, Comparator less_than)
+{
+	applyNetwork<N>(a, less_than, make_index_sequence<SortingNetwork<N>::length>{});
+}
+
+/**
+ * Internal method that returns the network sort for n items,
+ * where n is at most MAX_NETWORK_SIZE.
+ */
+template <typename Comparable, typename Comparator, size_t... N>
+auto networkFor(int n, index_sequence<N...>) -> void (*)(Comparable*, Comparator)
+{
+	static void (* const table[])(Comparable*, Comparator) = { &networkSort<int(N), Comparable, Comparator>... };
+	return table[n];
+}
+
+template <typename Comparable, typename Comparator>
+auto networkFor(int n) -> void (*)(Comparable*, Comparator)
+{
+	return networkFor<Comparable, Comparator>(n, make_index_sequence<MAX_NETWORK_SIZE + 1>{});
+}
+
+/**
+ * Sorts a single group a[left..right].
+ * Uses the sorting network for the group size, or quicksort if the
+ * group is larger than MAX_NETWORK_SIZE.
+ */
+template <typename Comparable, typename Comparator>
+void sortGroup(vector<Comparable>& a, Comparator less_than, int left, int right)
+{
+	int n = right - left + 1;
+
+	if (n <= MAX_NETWORK_SIZE)
+	{
+		if (n > 1)
+			networkFor<Comparable, Comparator>(n)(&a[left], less_than);
+	}
+	else
+		quicksort(a, less_than, left, right);
+}
+
+/**
+ * Internal method that splits numGroups groups into contiguous chunks
+ * and runs sortChunk(firstGroup, lastGroup) on each chunk.
+ * The chunks run on numThreads threads; the calling thread takes the last one.
+ */
+template <typename ChunkSorter>
+void forEachGroupChunk(int numGroups, int numThreads, ChunkSorter sortChunk)
+{
+	if (numThreads > numGroups)
+		numThreads = numGroups;
+	if (numThreads <= 1)
+	{
+		sortChunk(0, numGroups);
+		return;
+	}
+
+	vector<thread> workers;
+	int chunk = (numGroups + numThreads - 1) / numThreads;
+	for (int first = 0; first < numGroups; first += chunk)
+	{
+		int last = std::min(first + chunk, numGroups);
+		if (last == numGroups)
+			sortChunk(first, last);
+		else
+			workers.emplace_back(sortChunk, first, last);
+	}
+	for (auto& w : workers)
+		w.join();
+}
+
+/**
+ * Batched sort of variable sized groups.
+ * a is the flat array holding every group back to back.
+ * offsets holds the start of each group followed by the end of the last one,
+ * so group g is a[offsets[g]..offsets[g+1]-1].
+ * numThreads is the number of threads the groups are spread across.
+ */
+template <typename Comparable, typename Comparator>
+void sortGroups(vector<Comparable>& a, const vector<int>& offsets, Comparator less_than, int numThreads = 1)
+{
+	int numGroups = int(offsets.size()) - 1;
+	if (numGroups <= 0)
+		return;
+
+	forEachGroupChunk(numGroups, numThreads, [&](int first, int last)
+	{
+		for (int g = first; g < last; ++g)
+			sortGroup(a, less_than, offsets[g], offsets[g + 1] - 1);
+	});
+}
+
+/**
+ * Batched sort of fixed size groups.
+ * a is the flat array holding every group back to back.
+ * groupSize is the number of items in each group; the last group
+ * may be shorter if groupSize does not divide a.size().
+ * numThreads is the number of threads the groups are spread across.
+ */
+template <typename Comparable, typename Comparator>
+void sortGroups(vector<Comparable>& a, int groupSize, Comparator less_than, int numThreads = 1)
+{
+	int n = a.size();
+	if (groupSize <= 1 || n <= 1)
+		return;
+
+	int fullGroups = n / groupSize;
+	int numGroups = (n + groupSize - 1) / groupSize;
+
+	forEachGroupChunk(numGroups, numThreads, [&](int first, int last)
+	{
+		int g = first;
+		if (groupSize <= MAX_NETWORK_SIZE)
+		{
+			// Look up the network once for all full groups in this chunk
+			auto network = networkFor<Comparable, Comparator>(groupSize);
+			for (; g < last && g < fullGroups; ++g)
+				network(&a[g * groupSize], less_than);
+		}
+		for (; g < last; ++g)
+			sortGroup(a, less_than, g * groupSize, std::min((g + 1) * groupSize, n) - 1);
+	});
+}
+
+#endif
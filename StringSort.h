@@ -0,0 +1,338 @@
+/*
+	This is the StringSort.h header file.
+	This file contains the sorting routines specialized for string keys:
+	multikey (three-way radix) quicksort, MSD radix sort and LCP mergesort.
+
+	Unlike the routines in Sort.h these do not compare whole keys through a
+	Comparator. They look at one character position at a time, so shared
+	prefixes are only scanned once instead of at every level of recursion.
+	Keys are ordered lexicographically by unsigned byte value, with a
+	shorter key ordered before any longer key that it is a prefix of.
+
+	Keys may be std::string, string_view or PrefixedBytes (a pointer to a
+	length-prefixed byte array). Other key types can be supported by
+	adding an overload of keyView.
+*/
+
+#ifndef STRING_SORT_H
+#define STRING_SORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+/**
+ * A key stored as a length-prefixed byte array:
+ * a 4-byte little-endian length followed by that many bytes.
+ */
+struct PrefixedBytes
+{
+	const unsigned char* data;
+};
+
+/**
+ * Returns the bytes of a key.
+ */
+inline string_view keyView(const string& s)
+{
+	return string_view(s);
+}
+
+inline string_view keyView(string_view s)
+{
+	return s;
+}
+
+inline string_view keyView(const PrefixedBytes& s)
+{
+	uint32_t length = uint32_t(s.data[0]) | uint32_t(s.data[1]) << 8 |
+		uint32_t(s.data[2]) << 16 | uint32_t(s.data[3]) << 24;
+	return string_view(reinterpret_cast<const char*>(s.data + 4), length);
+}
+
+/**
+ * Returns the character of key s at position d, shifted up by one,
+ * or 0 if s has no position d. 0 therefore marks the end of the key.
+ */
+inline int charAt(string_view s, int d)
+{
+	return d < int(s.size()) ? int((unsigned char)s[d]) + 1 : 0;
+}
+
+/**
+ * Internal method that compares s and t, assuming their first d
+ * characters are equal.
+ * Stores the length of their common prefix in lcp.
+ * Returns a negative number, 0 or a positive number if s is
+ * less than, equal to or greater than t.
+ */
+inline int compareFrom(string_view s, string_view t, int d, int& lcp)
+{
+	int n = std::min(s.size(), t.size());
+	while (d < n && s[d] == t[d])
+		++d;
+	lcp = d;
+
+	if (d < n)
+		return int((unsigned char)s[d]) - int((unsigned char)t[d]);
+	return int(s.size()) - int(t.size());
+}
+
+/**
+ * Internal insertion sort for string keys that is used by the
+ * string sorts for small subarrays.
+ * All keys in a[left..right] share their first d characters.
+ */
+template <typename StringKey>
+void stringInsertionSort(vector<StringKey>& a, int left, int right, int d)
+{
+	for (int p = left + 1; p <= right; ++p)
+	{
+		StringKey tmp = std::move(a[p]);
+		int j, lcp;
+
+		for (j = p; j > left && compareFrom(keyView(tmp), keyView(a[j - 1]), d, lcp) < 0; --j)
+			a[j] = std::move(a[j - 1]);
+		a[j] = std::move(tmp);
+	}
+}
+
+/**
+ * Internal multikey quicksort method that makes recursive calls.
+ * Partitions a[left..right] three ways on the character at position d,
+ * and only moves on to position d + 1 for the keys equal to the pivot.
+ * Uses a cutoff of 10.
+ */
+template <typename StringKey>
+void multikeyQuicksort(vector<StringKey>& a, int left, int right, int d)
+{
+	while (left + 10 <= right)
+	{
+		// Median of three characters as the pivot
+		int center = left + (right - left) / 2;
+		int x = charAt(keyView(a[left]), d);
+		int y = charAt(keyView(a[center]), d);
+		int z = charAt(keyView(a[right]), d);
+		int pivot = std::max(std::min(x, y), std::min(std::max(x, y), z));
+
+		// Dutch national flag partition: [left, lt) < pivot, [lt, gt] == pivot, (gt, right] > pivot
+		int lt = left, gt = right, i = left;
+		while (i <= gt)
+		{
+			int c = charAt(keyView(a[i]), d);
+			if (c < pivot)
+				std::swap(a[lt++], a[i++]);
+			else if (c > pivot)
+				std::swap(a[i], a[gt--]);
+			else
+				++i;
+		}
+
+		multikeyQuicksort(a, left, lt - 1, d);
+		multikeyQuicksort(a, gt + 1, right, d);
+
+		// Keys equal to the pivot share one more character; loop instead of recursing.
+		// If the pivot is the end of the key, those keys are all equal.
+		if (pivot == 0)
+			return;
+		left = lt;
+		right = gt;
+		++d;
+	}
+
+	stringInsertionSort(a, left, right, d);
+}
+
+/**
+ * Multikey quicksort algorithm (driver).
+ */
+template <typename StringKey>
+void multikeyQuicksort(vector<StringKey>& a)
+{
+	multikeyQuicksort(a, 0, int(a.size()) - 1, 0);
+}
+
+/**
+ * Internal MSD radix sort method that makes recursive calls.
+ * Distributes a[left..right] on the character at position d.
+ * The character of each key is read once into cache, so the
+ * counting and the distribution pass do not touch the keys' bytes again.
+ * Subarrays smaller than 32 keys are passed to multikey quicksort.
+ * tmpArray and cache have the same size as a.
+ */
+template <typename StringKey>
+void msdRadixSort(vector<StringKey>& a, vector<StringKey>& tmpArray,
+	vector<uint16_t>& cache, int left, int right, int d)
+{
+	for (; ; )
+	{
+		if (left + 32 > right)
+		{
+			multikeyQuicksort(a, left, right, d);
+			return;
+		}
+
+		int count[258] = { 0 };
+		for (int i = left; i <= right; ++i)
+		{
+			cache[i] = charAt(keyView(a[i]), d);
+			++count[cache[i] + 1];
+		}
+
+		// All keys share the character; skip the distribution pass and loop on the
+		// next character instead of recursing, so long shared prefixes use no stack
+		if (count[cache[left] + 1] == right - left + 1)
+		{
+			if (cache[left] == 0)
+				return;
+			++d;
+			continue;
+		}
+
+		for (int c = 0; c < 257; ++c)
+			count[c + 1] += count[c];
+
+		int start[257];
+		std::copy(count, count + 257, start);
+
+		for (int i = left; i <= right; ++i)
+			tmpArray[left + count[cache[i]]++] = std::move(a[i]);
+		for (int i = left; i <= right; ++i)
+			a[i] = std::move(tmpArray[i]);
+
+		// Bucket 0 holds keys that ended at position d; they are all equal
+		for (int c = 1; c < 257; ++c)
+			if (start[c] < count[c])
+				msdRadixSort(a, tmpArray, cache, left + start[c], left + count[c] - 1, d + 1);
+		return;
+	}
+}
+
+/**
+ * MSD radix sort algorithm (driver).
+ */
+template <typename StringKey>
+void msdRadixSort(vector<StringKey>& a)
+{
+	vector<StringKey> tmpArray(a.size());
+	vector<uint16_t> cache(a.size());
+
+	msdRadixSort(a, tmpArray, cache, 0, int(a.size()) - 1, 0);
+}
+
+/**
+ * Internal method that merges two sorted halves of a subarray,
+ * using the longest common prefix (LCP) of neighbouring keys to skip
+ * characters that are already known to be equal.
+ * a is an array of string keys.
+ * lcp[i] is the LCP of a[i - 1] and a[i] within each half.
+ * tmpArray and tmpLcp are arrays to place the merged result.
+ * leftPos is the left-most index of the subarray.
+ * rightPos is the index of the start of the second half.
+ * rightEnd is the right-most index of the subarray.
+ */
+template <typename StringKey>
+void lcpMerge(vector<StringKey>& a, vector<int>& lcp, vector<StringKey>& tmpArray,
+	vector<int>& tmpLcp, int leftPos, int rightPos, int rightEnd)
+{
+	int leftEnd = rightPos - 1;
+	int tmpPos = leftPos;
+	int start = leftPos;
+
+	// lcp of each head with the last key written out
+	int leftLcp = 0, rightLcp = 0;
+
+	while (leftPos <= leftEnd && rightPos <= rightEnd)
+	{
+		bool takeLeft;
+
+		// The head sharing more with the last key written out is the smaller one
+		if (leftLcp != rightLcp)
+			takeLeft = leftLcp > rightLcp;
+		else
+		{
+			int common;
+			takeLeft = compareFrom(keyView(a[leftPos]), keyView(a[rightPos]), leftLcp, common) <= 0;
+			if (takeLeft)
+				rightLcp = common;
+			else
+				leftLcp = common;
+		}
+
+		if (takeLeft)
+		{
+			tmpLcp[tmpPos] = leftLcp;
+			tmpArray[tmpPos++] = std::move(a[leftPos++]);
+			leftLcp = leftPos <= leftEnd ? lcp[leftPos] : 0;
+		}
+		else
+		{
+			tmpLcp[tmpPos] = rightLcp;
+			tmpArray[tmpPos++] = std::move(a[rightPos++]);
+			rightLcp = rightPos <= rightEnd ? lcp[rightPos] : 0;
+		}
+	}
+
+	while (leftPos <= leftEnd)    // Copy rest of first half
+	{
+		tmpLcp[tmpPos] = leftLcp;
+		tmpArray[tmpPos++] = std::move(a[leftPos++]);
+		leftLcp = leftPos <= leftEnd ? lcp[leftPos] : 0;
+	}
+
+	while (rightPos <= rightEnd)  // Copy rest of right half
+	{
+		tmpLcp[tmpPos] = rightLcp;
+		tmpArray[tmpPos++] = std::move(a[rightPos++]);
+		rightLcp = rightPos <= rightEnd ? lcp[rightPos] : 0;
+	}
+
+	// Copy tmpArray back
+	for (int i = start; i <= rightEnd; ++i)
+	{
+		a[i] = std::move(tmpArray[i]);
+		lcp[i] = tmpLcp[i];
+	}
+}
+
+/**
+ * Internal LCP mergesort method that makes recursive calls.
+ * Sorts a[left..right] and fills lcp[left + 1..right].
+ * Uses insertion sort on subarrays of 10 items or less.
+ */
+template <typename StringKey>
+void lcpMergeSort(vector<StringKey>& a, vector<int>& lcp, vector<StringKey>& tmpArray,
+	vector<int>& tmpLcp, int left, int right)
+{
+	if (left + 10 <= right)
+	{
+		int center = (left + right) / 2;
+		lcpMergeSort(a, lcp, tmpArray, tmpLcp, left, center);
+		lcpMergeSort(a, lcp, tmpArray, tmpLcp, center + 1, right);
+		lcpMerge(a, lcp, tmpArray, tmpLcp, left, center + 1, right);
+	}
+	else
+	{
+		stringInsertionSort(a, left, right, 0);
+		for (int i = left + 1; i <= right; ++i)
+			compareFrom(keyView(a[i - 1]), keyView(a[i]), 0, lcp[i]);
+	}
+}
+
+/**
+ * LCP mergesort algorithm (driver).
+ * Stable: equal keys keep their original order.
+ */
+template <typename StringKey>
+void lcpMergeSort(vector<StringKey>& a)
+{
+	vector<StringKey> tmpArray(a.size());
+	vector<int> lcp(a.size()), tmpLcp(a.size());
+
+	lcpMergeSort(a, lcp, tmpArray, tmpLcp, 0, int(a.size()) - 1);
+}
+
+#endif
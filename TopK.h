@@ -0,0 +1,198 @@
+/*
+	This is the TopK.h header file.
+	This file contains TopK, a fixed-capacity heap that keeps the k greatest
+	items (by a Comparator) seen in a stream, without storing the stream.
+
+	The kept items are held in a heap built with percDown from Sort.h, with
+	the comparison reversed so that the least kept item, the threshold a new
+	item has to beat, is at the root. Items are added one at a time or in
+	batches; a batch is first filtered against the threshold without
+	branching on each comparison. To keep the k smallest items instead,
+	use greater<> (or any reversed Comparator).
+
+	A TopK is not thread-safe. Give each thread its own and merge them.
+*/
+
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include "Sort.h"
+#include <cassert>
+#include <vector>
+using namespace std;
+
+/**
+ * Number of batch items filtered against the threshold at a time.
+ */
+const int TOPK_FILTER_BLOCK = 256;
+
+/**
+ * Comparator that orders items in reverse.
+ * Turns percDown's heap with the greatest item at the root into
+ * one with the least item at the root.
+ */
+template <typename Comparator>
+struct ReverseOrder
+{
+	Comparator less_than;
+
+	template <typename Comparable>
+	bool operator()(const Comparable& x, const Comparable& y) const
+	{
+		return less_than(y, x);
+	}
+};
+
+/**
+ * Keeps the k greatest items pushed into it.
+ */
+template <typename Comparable, typename Comparator>
+class TopK
+{
+public:
+	/**
+	 * k is the number of items kept.
+	 * arity is the number of children of each heap node, at least 2
+	 * (percDown cannot descend a heap of arity 0 or 1).
+	 */
+	explicit TopK(int k, Comparator less_than = Comparator(), int arity = 4)
+		: k(k), arity(arity), less_than(less_than), reversed{ less_than }
+	{
+		assert(arity >= 2);
+		heap.reserve(k > 0 ? k : 0);
+	}
+
+	int capacity() const { return k; }
+	int size() const { return heap.size(); }
+	bool full() const { return int(heap.size()) == k && k > 0; }
+
+	/**
+	 * Returns the least kept item, which a new item must beat.
+	 * The TopK must be full(): until then the kept items are not yet a heap,
+	 * and with none kept there is no threshold to return.
+	 */
+	const Comparable& threshold() const
+	{
+		assert(full());
+		return heap[0];
+	}
+
+	/**
+	 * Adds x if it is among the k greatest items so far.
+	 */
+	void push(const Comparable& x)
+	{
+		if (int(heap.size()) < k)
+		{
+			heap.push_back(x);
+			if (int(heap.size()) == k)
+				buildHeap();
+		}
+		else if (k > 0 && less_than(heap[0], x))
+			replaceThreshold(x);
+	}
+
+	/**
+	 * Adds the items of batch that are among the k greatest so far.
+	 * Once the TopK is full, each block of the batch is first compared
+	 * with the threshold, and the positions of the items that beat it are
+	 * collected without a branch; only those items touch the heap.
+	 */
+	void push(const vector<Comparable>& batch)
+	{
+		int n = batch.size();
+		int i = 0;
+
+		while (i < n && !full())
+			push(batch[i++]);
+		if (k <= 0)
+			return;
+
+		int candidates[TOPK_FILTER_BLOCK];
+		while (i < n)
+		{
+			int blockEnd = i + TOPK_FILTER_BLOCK < n ? i + TOPK_FILTER_BLOCK : n;
+			int found = 0;
+			const Comparable& limit = heap[0];
+
+			for (int j = i; j < blockEnd; ++j)
+			{
+				candidates[found] = j;
+				found += less_than(limit, batch[j]);
+			}
+
+			// The threshold may have risen since the block was filtered
+			for (int c = 0; c < found; ++c)
+				if (less_than(heap[0], batch[candidates[c]]))
+					replaceThreshold(batch[candidates[c]]);
+
+			i = blockEnd;
+		}
+	}
+
+	/**
+	 * Adds the items kept by other, so this keeps the k greatest of both.
+	 * Used to combine the TopKs filled by several threads.
+	 */
+	void merge(const TopK& other)
+	{
+		push(other.heap);
+	}
+
+	/**
+	 * Forgets every kept item, e.g. at the start of a new time window.
+	 */
+	void clear()
+	{
+		heap.clear();
+	}
+
+	/**
+	 * Returns the kept items, greatest first.
+	 */
+	vector<Comparable> sorted() const
+	{
+		vector<Comparable> a = heap;
+		int n = a.size();
+
+		if (n < k)
+			for (int i = (n - 2 + arity) / arity - 1; i >= 0; --i)  /* buildHeap */
+				percDown(a, reversed, i, n, arity);
+
+		// deleteMin moves the least item to the back each time
+		for (int j = n - 1; j > 0; --j)
+		{
+			std::swap(a[0], a[j]);
+			percDown(a, reversed, 0, j, arity);
+		}
+		return a;
+	}
+
+private:
+	/**
+	 * Internal method that puts the heap in order once it is full.
+	 */
+	void buildHeap()
+	{
+		int n = heap.size();
+		for (int i = (n - 2 + arity) / arity - 1; i >= 0; --i)
+			percDown(heap, reversed, i, n, arity);
+	}
+
+	/**
+	 * Internal method that replaces the least kept item with x.
+	 */
+	void replaceThreshold(const Comparable& x)
+	{
+		heap[0] = x;
+		percDown(heap, reversed, 0, heap.size(), arity);
+	}
+
+	int k;
+	int arity;
+	Comparator less_than;
+	ReverseOrder<Comparator> reversed;
+	vector<Comparable> heap;
+};
+
+#endif
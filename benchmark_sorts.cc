@@ -0,0 +1,883 @@
+/*
+	This is the benchmark_sorts.cc file.
+	This code is the performance regression suite for the sorting functions.
+	It runs every sorting function, and std::sort, std::stable_sort and
+	std::partial_sort for reference, on a fixed matrix of element types,
+	input distributions and sizes.
+
+	Before timing, the output of every function is checked against the
+	output of std::sort, and the output of the stable ones is checked for
+	stability. Each case is then timed (best of several runs), and
+	either recorded as the JSON baseline or compared with it. A comparison
+	fails, and prints every case that got slower than the noise threshold,
+	if any case regressed or any function gave a wrong result.
+
+	The small group cases time the batched sorting networks
+	("SortingNetwork.h") against std::sort on each group, for fixed and
+	variable group sizes.
+
+	The top-k cases time the streaming TopK heap ("TopK.h"), fed one item
+	at a time, in one batch, and in parts merged afterwards, against
+	std::partial_sort and std::nth_element for the k greatest items.
+
+	The multi-column cases sort trade records by tenant, timestamp
+	descending and price, by normalized key ("NormalizedKey.h") and with
+	a column-by-column comparator, inlined and behind a std::function.
+
+	The grouping cases time the semisort ("Semisort.h") against sorting
+	and then scanning for the runs of equal keys, on few-unique and
+	Zipfian int64 keys.
+
+	Usage: ./benchmark_sorts <record|compare> <baseline.json>
+	           [--max-size N] [--threshold F] [--runs R]
+*/
+
+#include "Sort.h"
+#include "IncrementalSort.h"
+#include "MultiwayMergeSort.h"
+#include "NormalizedKey.h"
+#include "SampleSort.h"
+#include "Semisort.h"
+#include "SortingNetwork.h"
+#include "SortDispatch.h"
+#include "SortVerify.h"
+#include "StringSort.h"
+#include "TopK.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Sizes in the matrix; cases above --max-size are skipped
+const long long MATRIX_SIZES[] = { 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+// Distributions in the matrix
+const char* const DISTRIBUTIONS[] = { "random", "sorted", "reversed", "few_unique" };
+
+// Group sizes of the small group cases; 0 stands for variable sizes from 1 to 40
+const int SMALL_GROUP_SIZES[] = { 4, 8, 16, 32, 0 };
+
+// Numbers of items kept in the top-k cases
+const int TOPK_SIZES[] = { 10, 1000 };
+
+// Number of parts the merged TopK case splits its input into
+const int TOPK_PARTS = 4;
+
+// Distributions of the multi-column cases
+const char* const MULTI_COLUMN_DISTRIBUTIONS[] = { "random", "few_unique" };
+
+// Distributions of the grouping cases
+const char* const GROUPING_DISTRIBUTIONS[] = { "few_unique", "zipf" };
+
+// Number of distinct values of the zipf distribution (fewer if the vector is smaller)
+const long long ZIPF_UNIVERSE = 1 << 20;
+
+// Cases faster than this in both the baseline and the current run are reported but never fail
+const long long NOISE_FLOOR_NS = 100000;
+
+// 64-byte record sorted by its key
+struct Record64 {
+	long long key;
+	char payload[56];
+
+	bool operator<(const Record64& other) const { return key < other.key; }
+};
+
+// Record sorted by its key whose payload is on the heap, so every copy allocates
+struct HeavyRecord {
+	long long key;
+	vector<long long> payload;
+
+	bool operator<(const HeavyRecord& other) const { return key < other.key; }
+};
+
+// Record of the multi-column cases; id is its position in the input
+struct Trade {
+	string tenant;
+	long long timestamp;
+	double price;
+	int id;
+};
+
+// Compares trades by tenant, timestamp descending, then price
+struct TradeLess {
+	bool operator()(const Trade& x, const Trade& y) const {
+		if (x.tenant != y.tenant)
+			return x.tenant < y.tenant;
+		if (x.timestamp != y.timestamp)
+			return x.timestamp > y.timestamp;
+		return x.price < y.price;
+	}
+};
+
+// Name of each element type in the case names
+template <typename Comparable> const char* TypeName();
+template <> const char* TypeName<int>() { return "int32"; }
+template <> const char* TypeName<long long>() { return "int64"; }
+template <> const char* TypeName<double>() { return "double"; }
+template <> const char* TypeName<string>() { return "string"; }
+template <> const char* TypeName<Record64>() { return "record64"; }
+template <> const char* TypeName<HeavyRecord>() { return "heavy"; }
+
+// Makes an element of each type from its position @value in the order
+template <typename Comparable> Comparable MakeItem(long long value, long long index);
+template <> int MakeItem<int>(long long value, long long) { return int(value); }
+template <> long long MakeItem<long long>(long long value, long long) { return value * 1000003; }
+template <> double MakeItem<double>(long long value, long long) { return value * 0.5; }
+template <> string MakeItem<string>(long long value, long long) {
+	// Zero padded, so string order is the same as numeric order
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "item/%012lld", value);
+	return buffer;
+}
+template <> Record64 MakeItem<Record64>(long long value, long long index) {
+	Record64 r;
+	r.key = value;
+	memset(r.payload, int(index & 0xff), sizeof(r.payload));
+	return r;
+}
+template <> HeavyRecord MakeItem<HeavyRecord>(long long value, long long index) {
+	HeavyRecord r;
+	r.key = value;
+	r.payload.assign(32, index);
+	return r;
+}
+
+// Position of an item in the generated vector, or -1 for types that do not record it
+template <typename Comparable> long long ItemIndex(const Comparable&) { return -1; }
+template <> long long ItemIndex<HeavyRecord>(const HeavyRecord& r) { return r.payload[0]; }
+
+// Generates and returns a vector of @size items of the given @distribution.
+// In zipf, the k-th most common value comes up in proportion to 1 / k.
+template <typename Comparable>
+vector<Comparable> GenerateVector(const string& distribution, long long size) {
+	vector<double> zipf_cdf;
+	if (distribution == "zipf") {
+		double total = 0;
+		for (long long k = 1; k <= min(size, ZIPF_UNIVERSE); ++k) {
+			total += 1.0 / k;
+			zipf_cdf.push_back(total);
+		}
+	}
+
+	vector<Comparable> a;
+	a.reserve(size);
+	for (long long i = 0; i < size; ++i) {
+		long long value;
+		if (distribution == "random")
+			value = (long long)rand() % 1000000000;
+		else if (distribution == "sorted")
+			value = i;
+		else if (distribution == "reversed")
+			value = size - i;
+		else if (distribution == "zipf")
+			value = lower_bound(zipf_cdf.begin(), zipf_cdf.end(), rand() / (RAND_MAX + 1.0) * zipf_cdf.back()) - zipf_cdf.begin();
+		else
+			value = rand() % 16;
+		a.push_back(MakeItem<Comparable>(value, i));
+	}
+	return a;
+}
+
+// One sorting function in the suite
+template <typename Comparable>
+struct Engine {
+	string name;
+	function<void(vector<Comparable>&)> run;
+	long long max_size;		// Larger inputs are skipped (for quadratic sorts)
+	bool stable = false;	// Keeps equal items in input order
+};
+
+// Adds the sorts that only work on one element type; none by default
+template <typename Comparable>
+void AddTypeSpecificEngines(vector<Engine<Comparable>>&) {
+}
+
+void AddTypeSpecificEngines(vector<Engine<string>>& engines) {
+	engines.push_back({ "multikey quicksort", [](vector<string>& a) { multikeyQuicksort(a); }, -1 });
+	engines.push_back({ "msd radix sort", [](vector<string>& a) { msdRadixSort(a); }, -1 });
+	engines.push_back({ "lcp mergesort", [](vector<string>& a) { lcpMergeSort(a); }, -1 });
+}
+
+// Returns every sorting function run for element type Comparable
+template <typename Comparable>
+vector<Engine<Comparable>> Engines() {
+	typedef less<Comparable> Less;
+	const int num_threads = max(1u, thread::hardware_concurrency());
+
+	vector<Engine<Comparable>> engines = {
+		{ "std::sort", [](vector<Comparable>& a) { std::sort(a.begin(), a.end()); }, -1 },
+		{ "std::stable_sort", [](vector<Comparable>& a) { std::stable_sort(a.begin(), a.end()); }, -1, true },
+		{ "std::partial_sort", [](vector<Comparable>& a) { std::partial_sort(a.begin(), a.end(), a.end()); }, -1 },
+		{ "quicksort", [](vector<Comparable>& a) { quicksort(a, Less{}); }, -1 },
+		{ "iterative quicksort", [](vector<Comparable>& a) { quicksortIterative(a, Less{}); }, -1 },
+		{ "middle pivot quicksort", [](vector<Comparable>& a) { quicksortMiddle(a, Less{}, 0, int(a.size())); }, -1 },
+		// Quadratic, and recursing once per item, on sorted input
+		{ "first pivot quicksort", [](vector<Comparable>& a) { quicksortFirst(a, Less{}, 0, int(a.size())); }, 10000 },
+		{ "incremental quicksort", [](vector<Comparable>& a) {
+			// Reads every item through the lazy view, one rank at a time
+			LazySortedView<Comparable, Less> view(a);
+			while (view.hasNext())
+				view.next();
+		}, -1 },
+		{ "dual pivot quicksort", [](vector<Comparable>& a) { multiPivotQuicksort(a, Less{}, 2); }, -1 },
+		{ "three pivot quicksort", [](vector<Comparable>& a) { multiPivotQuicksort(a, Less{}, 3); }, -1 },
+		{ "mergesort", [](vector<Comparable>& a) { mergeSort(a, Less{}); }, -1, true },
+		{ "multiway mergesort", [](vector<Comparable>& a) { multiwayMergeSort(a, Less{}); }, -1, true },
+		{ "heapsort", [](vector<Comparable>& a) { heapsort(a, Less{}); }, -1 },
+		{ "shellsort", [](vector<Comparable>& a) { shellsort(a); }, -1 },
+		{ "insertion sort", [](vector<Comparable>& a) { insertionSort(a, Less{}, 0, int(a.size()) - 1); }, 10000 },
+		{ "sample sort", [num_threads](vector<Comparable>& a) { sampleSort(a, Less{}, num_threads); }, -1 },
+		{ "adaptive sort", [num_threads](vector<Comparable>& a) {
+			SortHints hints;
+			hints.numThreads = num_threads;
+			sort(a, Less{}, hints);
+		}, -1 },
+	};
+	AddTypeSpecificEngines(engines);
+	return engines;
+}
+
+// Returns true if @a holds the same keys as @expected, position by position.
+// Items with equal keys are interchangeable, since not every sort is stable.
+template <typename Comparable>
+bool SameOrder(const vector<Comparable>& a, const vector<Comparable>& expected) {
+	if (a.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (a[i] < expected[i] || expected[i] < a[i])
+			return false;
+	return true;
+}
+
+// Hashes a whole item for multisetChecksum, the payload of a record included, so a sort that
+// loses or duplicates a record is caught even though every key is still in place
+struct RecordHash {
+	template <typename Comparable>
+	unsigned long long operator()(const Comparable& x) const { return ItemHash()(x); }
+
+	unsigned long long operator()(const Record64& r) const {
+		unsigned long long h = (unsigned long long)r.key;
+		for (size_t i = 0; i < sizeof(r.payload); i += 8) {
+			unsigned long long chunk;
+			memcpy(&chunk, r.payload + i, 8);
+			h = mixItemHash(h ^ chunk);
+		}
+		return h;
+	}
+
+	unsigned long long operator()(const HeavyRecord& r) const {
+		unsigned long long h = mixItemHash((unsigned long long)r.key ^ r.payload.size());
+		for (long long x : r.payload)
+			h = mixItemHash(h ^ (unsigned long long)x);
+		return h;
+	}
+};
+
+// Settings of one run of the suite
+struct SuiteOptions {
+	long long max_size = 100000;
+	double threshold = 0.10;
+	int runs = 3;
+};
+
+// @ options: Sizes and number of runs
+// @ results: Case name -> best runtime in nanoseconds
+// @ failures: Names of cases whose output was wrong
+// Function that checks and times every engine for element type Comparable
+template <typename Comparable>
+void RunType(const SuiteOptions& options, map<string, long long>& results, vector<string>& failures) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	const vector<Engine<Comparable>> engines = Engines<Comparable>();
+
+	for (const char* distribution : DISTRIBUTIONS) {
+		for (long long size : MATRIX_SIZES) {
+			if (size > options.max_size)
+				continue;
+
+			srand(size);
+			const vector<Comparable> input = GenerateVector<Comparable>(distribution, size);
+			vector<Comparable> expected = input;
+			std::sort(expected.begin(), expected.end());
+			const MultisetChecksum input_checksum = multisetChecksum(input, RecordHash());
+
+			for (const Engine<Comparable>& engine : engines) {
+				if (engine.max_size >= 0 && size > engine.max_size)
+					continue;
+
+				const string name = string(TypeName<Comparable>()) + "/" + distribution + "/" +
+					to_string(size) + "/" + engine.name;
+
+				// Check the result against std::sort, and that it holds the same records, before timing
+				vector<Comparable> a = input;
+				engine.run(a);
+				if (!SameOrder(a, expected) || multisetChecksum(a, RecordHash()) != input_checksum) {
+					cout << "WRONG RESULT " << name << endl;
+					failures.push_back(name);
+					continue;
+				}
+				if (engine.stable && size > 0 && ItemIndex(input[0]) >= 0 && !isStable(a, less<Comparable>{}, ItemIndex<Comparable>)) {
+					cout << "NOT STABLE " << name << endl;
+					failures.push_back(name);
+					continue;
+				}
+
+				long long best = -1;
+				for (int run = 0; run < options.runs; ++run) {
+					a = input;
+					const auto begin = Time::now();
+					engine.run(a);
+					const auto end = Time::now();
+					long long ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+					if (best < 0 || ns < best)
+						best = ns;
+				}
+				results[name] = best;
+				cout << left << setw(56) << name << right << setw(14) << best << " ns" << endl;
+			}
+		}
+	}
+}
+
+// Returns the start of every group of @size items, followed by @size, for groups of @group_size items,
+// or of random sizes from 1 to 40 if @group_size is 0
+vector<int> SmallGroupOffsets(long long size, int group_size) {
+	vector<int> offsets;
+	for (long long start = 0; start < size; start += group_size > 0 ? group_size : 1 + rand() % 40)
+		offsets.push_back(start);
+	offsets.push_back(size);
+	return offsets;
+}
+
+// @ options: Sizes and number of runs
+// @ results: Case name -> best runtime in nanoseconds
+// @ failures: Names of cases whose output was wrong
+// Function that checks and times sorting many small groups with sortGroups, against std::sort on each group
+template <typename Comparable>
+void RunSmallGroups(const SuiteOptions& options, map<string, long long>& results, vector<string>& failures) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	const int num_threads = max(1u, thread::hardware_concurrency());
+
+	for (int group_size : SMALL_GROUP_SIZES) {
+		for (long long size : MATRIX_SIZES) {
+			if (size > options.max_size)
+				continue;
+
+			srand(size);
+			const vector<Comparable> input = GenerateVector<Comparable>("random", size);
+			const vector<int> offsets = SmallGroupOffsets(size, group_size);
+			const string group_name = group_size > 0 ? to_string(group_size) : string("variable");
+
+			const vector<pair<string, function<void(vector<Comparable>&)>>> engines = {
+				{ "sorting network", [&](vector<Comparable>& a) {
+					if (group_size > 0)
+						sortGroups(a, group_size, less<Comparable>{}, num_threads);
+					else
+						sortGroups(a, offsets, less<Comparable>{}, num_threads);
+				} },
+				{ "std::sort per group", [&](vector<Comparable>& a) {
+					for (size_t g = 0; g + 1 < offsets.size(); ++g)
+						std::sort(a.begin() + offsets[g], a.begin() + offsets[g + 1]);
+				} },
+			};
+
+			vector<Comparable> expected = input;
+			engines.back().second(expected);
+			const MultisetChecksum input_checksum = multisetChecksum(input, RecordHash());
+
+			for (auto& engine : engines) {
+				const string name = string("groups/") + TypeName<Comparable>() + "/" + group_name + "/" +
+					to_string(size) + "/" + engine.first;
+
+				// Check every group against std::sort, and that it holds the same items, before timing
+				vector<Comparable> a = input;
+				engine.second(a);
+				if (!SameOrder(a, expected) || multisetChecksum(a, RecordHash()) != input_checksum) {
+					cout << "WRONG RESULT " << name << endl;
+					failures.push_back(name);
+					continue;
+				}
+
+				long long best = -1;
+				for (int run = 0; run < options.runs; ++run) {
+					a = input;
+					const auto begin = Time::now();
+					engine.second(a);
+					const auto end = Time::now();
+					long long ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+					if (best < 0 || ns < best)
+						best = ns;
+				}
+				results[name] = best;
+				cout << left << setw(56) << name << right << setw(14) << best << " ns" << endl;
+			}
+		}
+	}
+}
+
+// @ options: Sizes and number of runs
+// @ results: Case name -> best runtime in nanoseconds
+// @ failures: Names of cases whose output was wrong
+// Function that checks and times finding the k greatest items, greatest first, with TopK
+// and with std::partial_sort and std::nth_element
+template <typename Comparable>
+void RunTopK(const SuiteOptions& options, map<string, long long>& results, vector<string>& failures) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+	typedef TopK<Comparable, less<Comparable>> Heap;
+
+	for (int k : TOPK_SIZES) {
+		const vector<pair<string, function<vector<Comparable>(vector<Comparable>&)>>> engines = {
+			{ "TopK push", [k](vector<Comparable>& a) {
+				Heap top(k);
+				for (const Comparable& x : a)
+					top.push(x);
+				return top.sorted();
+			} },
+			{ "TopK batch", [k](vector<Comparable>& a) {
+				Heap top(k);
+				top.push(a);
+				return top.sorted();
+			} },
+			{ "TopK merged parts", [k](vector<Comparable>& a) {
+				// As each thread would fill its own TopK
+				vector<Heap> parts(TOPK_PARTS, Heap(k));
+				for (int p = 0; p < TOPK_PARTS; ++p)
+					parts[p].push(vector<Comparable>(a.begin() + a.size() * p / TOPK_PARTS,
+						a.begin() + a.size() * (p + 1) / TOPK_PARTS));
+				for (int p = 1; p < TOPK_PARTS; ++p)
+					parts[0].merge(parts[p]);
+				return parts[0].sorted();
+			} },
+			{ "std::nth_element then sort", [k](vector<Comparable>& a) {
+				const int kept = min<size_t>(k, a.size());
+				std::nth_element(a.begin(), a.begin() + kept, a.end(), greater<Comparable>());
+				std::sort(a.begin(), a.begin() + kept, greater<Comparable>());
+				a.resize(kept);
+				return a;
+			} },
+			{ "std::partial_sort", [k](vector<Comparable>& a) {
+				const int kept = min<size_t>(k, a.size());
+				std::partial_sort(a.begin(), a.begin() + kept, a.end(), greater<Comparable>());
+				a.resize(kept);
+				return a;
+			} },
+		};
+
+		for (const char* distribution : DISTRIBUTIONS) {
+			for (long long size : MATRIX_SIZES) {
+				if (size > options.max_size)
+					continue;
+
+				srand(size);
+				const vector<Comparable> input = GenerateVector<Comparable>(distribution, size);
+				vector<Comparable> a = input;
+				const vector<Comparable> expected = engines.back().second(a);
+
+				for (auto& engine : engines) {
+					const string name = string("topk/") + TypeName<Comparable>() + "/" + distribution + "/" +
+						to_string(size) + "/k=" + to_string(k) + "/" + engine.first;
+
+					// Check the kept items against std::partial_sort before timing
+					a = input;
+					if (!SameOrder(engine.second(a), expected)) {
+						cout << "WRONG RESULT " << name << endl;
+						failures.push_back(name);
+						continue;
+					}
+
+					long long best = -1;
+					for (int run = 0; run < options.runs; ++run) {
+						a = input;
+						const auto begin = Time::now();
+						engine.second(a);
+						const auto end = Time::now();
+						long long ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+						if (best < 0 || ns < best)
+							best = ns;
+					}
+					results[name] = best;
+					cout << left << setw(56) << name << right << setw(14) << best << " ns" << endl;
+				}
+			}
+		}
+	}
+}
+
+// Generates and returns @size trades of the given @distribution; few_unique draws every
+// column from a handful of values, so most trades tie on their first columns
+vector<Trade> GenerateTrades(const string& distribution, long long size) {
+	const int values = distribution == "few_unique" ? 4 : 1000000;
+	vector<Trade> a;
+	a.reserve(size);
+	for (long long i = 0; i < size; ++i) {
+		Trade t;
+		t.tenant = "tenant/" + to_string(rand() % (distribution == "few_unique" ? 4 : 1000));
+		t.timestamp = 1500000000000LL + rand() % values;
+		t.price = (rand() % values) / 100.0;
+		t.id = int(i);
+		a.push_back(t);
+	}
+	return a;
+}
+
+// @ options: Sizes and number of runs
+// @ results: Case name -> best runtime in nanoseconds
+// @ failures: Names of cases whose output was wrong
+// Function that checks and times sorting trades on three columns by normalized key, against
+// quicksort, std::sort and std::stable_sort with a column-by-column comparator
+void RunMultiColumn(const SuiteOptions& options, map<string, long long>& results, vector<string>& failures) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	KeySchema<Trade> schema;
+	schema.addString([](const Trade& t) -> const string& { return t.tenant; }, 16)
+		.addInt([](const Trade& t) { return t.timestamp; }, KeyOrder::Descending)
+		.addFloat([](const Trade& t) { return t.price; });
+	const function<bool(const Trade&, const Trade&)> not_inlined = TradeLess();
+
+	// Engines marked stable must give the same trades as std::stable_sort, in the same order
+	const vector<Engine<Trade>> engines = {
+		{ "normalized key", [&](vector<Trade>& a) { sortByNormalizedKey(a, schema); }, -1 },
+		{ "normalized key stable", [&](vector<Trade>& a) { sortByNormalizedKey(a, schema, true); }, -1, true },
+		{ "quicksort, comparator", [](vector<Trade>& a) { quicksort(a, TradeLess()); }, -1 },
+		{ "quicksort, std::function comparator", [&](vector<Trade>& a) { quicksort(a, not_inlined); }, -1 },
+		{ "std::sort, comparator", [](vector<Trade>& a) { std::sort(a.begin(), a.end(), TradeLess()); }, -1 },
+		{ "std::stable_sort, comparator", [](vector<Trade>& a) {
+			std::stable_sort(a.begin(), a.end(), TradeLess());
+		}, -1, true },
+	};
+
+	for (const char* distribution : MULTI_COLUMN_DISTRIBUTIONS) {
+		for (long long size : MATRIX_SIZES) {
+			if (size > options.max_size)
+				continue;
+
+			srand(size);
+			const vector<Trade> input = GenerateTrades(distribution, size);
+			vector<Trade> expected = input;
+			engines.back().run(expected);
+
+			for (auto& engine : engines) {
+				const string name = string("multicolumn/") + distribution + "/" + to_string(size) + "/" + engine.name;
+
+				// Check the order against std::stable_sort before timing
+				vector<Trade> a = input;
+				engine.run(a);
+				bool correct = a.size() == expected.size();
+				for (size_t i = 0; correct && i < a.size(); ++i)
+					correct = engine.stable ? a[i].id == expected[i].id :
+						!TradeLess()(a[i], expected[i]) && !TradeLess()(expected[i], a[i]);
+				if (!correct) {
+					cout << "WRONG RESULT " << name << endl;
+					failures.push_back(name);
+					continue;
+				}
+
+				long long best = -1;
+				for (int run = 0; run < options.runs; ++run) {
+					a = input;
+					const auto begin = Time::now();
+					engine.run(a);
+					const auto end = Time::now();
+					long long ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+					if (best < 0 || ns < best)
+						best = ns;
+				}
+				results[name] = best;
+				cout << left << setw(56) << name << right << setw(14) << best << " ns" << endl;
+			}
+		}
+	}
+}
+
+// Returns the boundaries of the runs of equal items of the sorted vector @a, as semisort does
+vector<int> ScanGroups(const vector<long long>& a) {
+	vector<int> bounds;
+	for (int i = 0; i < int(a.size()); ++i)
+		if (i == 0 || a[i] != a[i - 1])
+			bounds.push_back(i);
+	bounds.push_back(a.size());
+	return bounds;
+}
+
+// Returns true if @bounds splits @a into groups of equal items, with no value in two groups,
+// and @a holds the items summed up in @input_checksum
+bool ValidGroups(const vector<long long>& a, const vector<int>& bounds, const MultisetChecksum& input_checksum) {
+	if (bounds.empty() || bounds.front() != 0 || bounds.back() != int(a.size()))
+		return false;
+	vector<long long> keys;
+	for (size_t g = 0; g + 1 < bounds.size(); ++g) {
+		if (bounds[g] >= bounds[g + 1])
+			return false;
+		for (int i = bounds[g]; i < bounds[g + 1]; ++i)
+			if (a[i] != a[bounds[g]])
+				return false;
+		keys.push_back(a[bounds[g]]);
+	}
+	std::sort(keys.begin(), keys.end());
+	return adjacent_find(keys.begin(), keys.end()) == keys.end() && multisetChecksum(a) == input_checksum;
+}
+
+// @ options: Sizes and number of runs
+// @ results: Case name -> best runtime in nanoseconds
+// @ failures: Names of cases whose output was wrong
+// Function that checks and times grouping equal int64 keys with the semisort and with
+// a sort followed by a scan for the runs of equal keys
+void RunGrouping(const SuiteOptions& options, map<string, long long>& results, vector<string>& failures) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	const int num_threads = max(1u, thread::hardware_concurrency());
+	const auto identity = [](long long x) { return x; };
+	const vector<pair<string, function<vector<int>(vector<long long>&)>>> engines = {
+		{ "semisort", [&](vector<long long>& a) { return semisort(a, identity, num_threads); } },
+		{ "quicksort then scan", [](vector<long long>& a) { quicksort(a, less<long long>{}); return ScanGroups(a); } },
+		{ "std::sort then scan", [](vector<long long>& a) { std::sort(a.begin(), a.end()); return ScanGroups(a); } },
+	};
+
+	for (const char* distribution : GROUPING_DISTRIBUTIONS) {
+		for (long long size : MATRIX_SIZES) {
+			if (size > options.max_size)
+				continue;
+
+			srand(size);
+			const vector<long long> input = GenerateVector<long long>(distribution, size);
+			const MultisetChecksum input_checksum = multisetChecksum(input);
+
+			for (auto& engine : engines) {
+				const string name = string("group/int64/") + distribution + "/" + to_string(size) + "/" + engine.first;
+
+				// Check the groups before timing
+				vector<long long> a = input;
+				if (!ValidGroups(a, engine.second(a), input_checksum)) {
+					cout << "WRONG RESULT " << name << endl;
+					failures.push_back(name);
+					continue;
+				}
+
+				long long best = -1;
+				for (int run = 0; run < options.runs; ++run) {
+					a = input;
+					const auto begin = Time::now();
+					engine.second(a);
+					const auto end = Time::now();
+					long long ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+					if (best < 0 || ns < best)
+						best = ns;
+				}
+				results[name] = best;
+				cout << left << setw(56) << name << right << setw(14) << best << " ns" << endl;
+			}
+		}
+	}
+}
+
+// @ options: Sizes in the matrix
+// Function that prints, for random int32 input of every size, how many passes over memory
+// mergesort and the multiway mergesort make and how many bytes they read and write.
+// These are estimates worked out from the pass counts and the cache size, not measured
+void ReportMemoryTraffic(const SuiteOptions& options) {
+	cout << "===============================================================" << endl;
+	cout << "Memory traffic, int32/random (estimated bytes read and written, from the pass counts; not measured)" << endl;
+
+	for (long long size : MATRIX_SIZES) {
+		if (size > options.max_size)
+			continue;
+
+		// The levels of mergesort's recursion that merge runs smaller than a cache block stay
+		// in the cache and count as one pass together; every level above is a pass of its own.
+		// Each level merges into tmpArray and copies back
+		const long long block = detectCacheSize() / (2 * sizeof(int));
+		long long levels = 1;
+		for (long long width = block; width < size; width *= 2)
+			++levels;
+
+		srand(size);
+		vector<int> a = GenerateVector<int>("random", size);
+		const MultiwayMergeStats stats = multiwayMergeSort(a, less<int>{});
+
+		cout << left << setw(12) << size << right
+			<< "mergesort: " << setw(3) << levels << " passes ~" << setw(14) << levels * 4 * size * (long long)sizeof(int)
+			<< "   multiway mergesort: " << setw(3) << stats.passes << " passes ~" << setw(14) << stats.bytesMoved
+			<< " (blocks of " << stats.blockSize << ", " << stats.runs << " runs, fan-in " << stats.fanIn << ")" << endl;
+	}
+}
+
+// Writes @results to @path as a JSON baseline. Returns false if the file can't be written.
+bool WriteBaseline(const string& path, const map<string, long long>& results) {
+	ofstream out(path);
+	out << "{" << endl;
+	out << "  \"unit\": \"ns\"," << endl;
+	out << "  \"cases\": {" << endl;
+	size_t i = 0;
+	for (auto& entry : results) {
+		out << "    \"" << entry.first << "\": " << entry.second << (++i < results.size() ? "," : "") << endl;
+	}
+	out << "  }" << endl;
+	out << "}" << endl;
+	return bool(out);
+}
+
+// Reads a JSON baseline written by WriteBaseline from @path into @results.
+// Returns false if the file can't be read.
+bool ReadBaseline(const string& path, map<string, long long>& results) {
+	ifstream in(path);
+	if (!in)
+		return false;
+
+	stringstream contents;
+	contents << in.rdbuf();
+	const string text = contents.str();
+
+	// Every case is a "name": number pair
+	const regex entry("\"([^\"]+)\"\\s*:\\s*([0-9]+)");
+	for (sregex_iterator it(text.begin(), text.end(), entry), end; it != end; ++it) {
+		results[(*it)[1].str()] = stoll((*it)[2].str());
+	}
+	return true;
+}
+
+// Formats @ns nanoseconds for the diff report
+string FormatTime(long long ns) {
+	ostringstream out;
+	out << fixed << setprecision(3) << ns / 1e6 << "ms";
+	return out.str();
+}
+
+// @ baseline: Runtimes from the baseline file
+// @ results: Runtimes from this run
+// @ threshold: Allowed slowdown, as a fraction
+// Function that prints every case that got slower or faster than the threshold,
+// and returns the number of regressions
+int CompareWithBaseline(const map<string, long long>& baseline, const map<string, long long>& results, double threshold) {
+	int regressions = 0, improvements = 0, new_cases = 0;
+
+	cout << "===============================================================" << endl;
+	cout << "Comparison with baseline (threshold " << threshold * 100 << "%)" << endl;
+
+	for (auto& entry : results) {
+		auto found = baseline.find(entry.first);
+		if (found == baseline.end()) {
+			++new_cases;
+			continue;
+		}
+
+		const long long before = found->second, now = entry.second;
+		const double change = before > 0 ? double(now - before) / before : 0;
+		const bool above_noise = before >= NOISE_FLOOR_NS || now >= NOISE_FLOOR_NS;
+
+		if (change > threshold && above_noise) {
+			++regressions;
+			cout << "REGRESSION  " << left << setw(56) << entry.first << right << FormatTime(before) << " -> "
+				<< FormatTime(now) << " (+" << fixed << setprecision(1) << change * 100 << "%)" << endl;
+		}
+		else if (change < -threshold && above_noise) {
+			++improvements;
+			cout << "improvement " << left << setw(56) << entry.first << right << FormatTime(before) << " -> "
+				<< FormatTime(now) << " (" << fixed << setprecision(1) << change * 100 << "%)" << endl;
+		}
+	}
+
+	cout << "---------------------------------------------------------------" << endl;
+	cout << results.size() << " cases: " << regressions << " regressions, " << improvements
+		<< " improvements, " << new_cases << " not in baseline" << endl;
+	return regressions;
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc < 3 || (string(argv[1]) != "record" && string(argv[1]) != "compare")) {
+		cout << "Usage: " << argv[0] << " <record|compare> <baseline.json> [--max-size N] [--threshold F] [--runs R]" << endl;
+		return 2;
+	}
+
+	const string mode = argv[1];
+	const string baseline_path = argv[2];
+	SuiteOptions options;
+	for (int i = 3; i + 1 < argc; i += 2) {
+		const string flag = argv[i];
+		if (flag == "--max-size")
+			options.max_size = stoll(argv[i + 1]);
+		else if (flag == "--threshold")
+			options.threshold = stod(argv[i + 1]);
+		else if (flag == "--runs")
+			options.runs = max(1, stoi(argv[i + 1]));
+		else {
+			cout << "Unknown option " << flag << endl;
+			return 2;
+		}
+	}
+
+	map<string, long long> baseline;
+	if (mode == "compare" && !ReadBaseline(baseline_path, baseline)) {
+		cout << "Cannot read baseline " << baseline_path << "; run with 'record' first" << endl;
+		return 2;
+	}
+
+	cout << "Running sort benchmark suite: sizes up to " << options.max_size << ", best of "
+		<< options.runs << " runs" << endl;
+
+	// Read the sort profile now, so the first timed sort does not
+	loadSortProfiles<int, long long, double, string, Record64, HeavyRecord, Trade, NormalizedKeyRef>();
+
+	map<string, long long> results;
+	vector<string> failures;
+	RunType<int>(options, results, failures);
+	RunType<long long>(options, results, failures);
+	RunType<double>(options, results, failures);
+	RunType<string>(options, results, failures);
+	RunType<Record64>(options, results, failures);
+	RunType<HeavyRecord>(options, results, failures);
+	RunSmallGroups<int>(options, results, failures);
+	RunSmallGroups<double>(options, results, failures);
+	RunTopK<int>(options, results, failures);
+	RunTopK<double>(options, results, failures);
+	RunMultiColumn(options, results, failures);
+	RunGrouping(options, results, failures);
+	ReportMemoryTraffic(options);
+
+	int regressions = 0;
+	if (mode == "record") {
+		if (!WriteBaseline(baseline_path, results)) {
+			cout << "Cannot write baseline " << baseline_path << endl;
+			return 2;
+		}
+		cout << "Recorded " << results.size() << " cases in " << baseline_path << endl;
+	}
+	else {
+		regressions = CompareWithBaseline(baseline, results, options.threshold);
+	}
+
+	for (const string& name : failures) {
+		cout << "WRONG RESULT " << name << endl;
+	}
+
+	return regressions > 0 || !failures.empty() ? 1 : 0;
+}
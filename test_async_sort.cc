@@ -0,0 +1,345 @@
+/*
+	This is the test_async_sort.cc file.
+	This code runs the asynchronous sorts of AsyncSort.h and checks what they
+	promise: the result of a finished sort, a batch of many small sorts on a
+	one-thread pool, a sort cancelled part way, a sort that runs past its
+	deadline, and a comparator that throws. A sort that does not finish must
+	leave the vector a permutation of its input.
+*/
+
+#include "Sort.h"
+#include "AsyncSort.h"
+#include "SortVerify.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Number of small sorts submitted at once in the batching check
+const int NUM_SMALL_SORTS = 1000;
+
+// Number of items in each of them
+const int SMALL_SORT_SIZE = 100;
+
+// Comparator that counts its calls and, once @trigger calls have been made, runs @action once.
+// Copies share the count, so the pool's copy and the caller's see the same calls.
+template <typename Comparator>
+struct TriggerComparator {
+	Comparator less_than;
+	shared_ptr<atomic<long long>> calls;
+	long long trigger;
+	function<void()> action;
+
+	bool operator()(int x, int y) const {
+		if (calls->fetch_add(1, memory_order_relaxed) + 1 == trigger)
+			action();
+		return less_than(x, y);
+	}
+};
+
+// Returns a TriggerComparator for @less_than that runs @action on call number @trigger
+template <typename Comparator>
+TriggerComparator<Comparator> MakeTrigger(Comparator less_than, long long trigger, function<void()> action) {
+	return TriggerComparator<Comparator>{ less_than, make_shared<atomic<long long>>(0), trigger, action };
+}
+
+// Returns the name of @status for the report
+string StatusName(SortStatus status) {
+	switch (status) {
+	case SortStatus::Queued: return "queued";
+	case SortStatus::Running: return "running";
+	case SortStatus::Done: return "done";
+	case SortStatus::Cancelled: return "cancelled";
+	case SortStatus::DeadlineExceeded: return "deadline exceeded";
+	default: return "failed";
+	}
+}
+
+// Returns the name of @algorithm for the report
+string AlgorithmName(SortAlgorithm algorithm) {
+	return algorithm == SortAlgorithm::MergeSort ? "mergesort" : "quicksort";
+}
+
+// @ check: What was checked
+// @ passed: Whether it held
+// @ failures: Number of failed checks so far
+// Function that prints one check and counts it if it failed
+void Report(const string& check, bool passed, int& failures) {
+	cout << "\t" << check << ": " << passed << endl;
+	if (!passed)
+		++failures;
+}
+
+// @ future: The handle of a sort that is expected to stop early
+// @ expected: The status the sort should end with
+// Function that returns true if get() throws SortCancelled with the deadline flag matching @expected
+bool ThrowsCancelled(const SortFuture& future, SortStatus expected) {
+	try {
+		future.get();
+	}
+	catch (const SortCancelled& cancelled) {
+		return cancelled.deadlineExceeded == (expected == SortStatus::DeadlineExceeded);
+	}
+	return false;
+}
+
+// @ algorithm: quicksort or mergesort
+// @ input: Vector to sort
+// @ less_than: less<int>{} or greater<int>{}
+// @ failures: Number of failed checks so far
+// Function that sorts a copy of @input asynchronously, waits, and checks the order, the permutation and the progress
+template <typename Comparator>
+void CheckFinishedSort(SortAlgorithm algorithm, const vector<int>& input, Comparator less_than, int& failures) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	vector<int> a = input;
+	SortPolicy policy;
+	policy.algorithm = algorithm;
+
+	const auto begin = Time::now();
+	SortFuture future = sortAsync(a, less_than, policy);
+	future.get();
+	const auto end = Time::now();
+
+	cout << "---------------------------" << endl;
+	cout << "sortAsync (" << AlgorithmName(algorithm) << "):\nRuntime: "
+		<< chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+	Report("Status done", future.status() == SortStatus::Done, failures);
+	Report("Verified", isSortedParallel(a, less_than), failures);
+	Report("Permutation", multisetChecksum(a) == multisetChecksum(input), failures);
+	Report("Progress 1", future.progress() == 1.0, failures);
+}
+
+// @ less_than: less<int>{} or greater<int>{}
+// @ failures: Number of failed checks so far
+// Function that submits many small sorts at once to a one-thread pool, which has to run them
+// in batches, and checks every result
+template <typename Comparator>
+void CheckBatchedSorts(Comparator less_than, int& failures) {
+	vector<vector<int>> inputs(NUM_SMALL_SORTS), outputs;
+	for (auto& input : inputs)
+		for (int i = 0; i < SMALL_SORT_SIZE; ++i)
+			input.push_back(rand());
+	outputs = inputs;
+
+	vector<SortFuture> futures;
+	bool all_sorted = true, all_permutations = true;
+	{
+		SortThreadPool pool(1);
+		for (auto& a : outputs)
+			futures.push_back(sortAsync(a, less_than, SortPolicy(), pool));
+		for (auto& future : futures)
+			future.get();
+	}
+	for (int s = 0; s < NUM_SMALL_SORTS; ++s) {
+		all_sorted = all_sorted && isSortedParallel(outputs[s], less_than);
+		all_permutations = all_permutations && multisetChecksum(outputs[s]) == multisetChecksum(inputs[s]);
+	}
+
+	cout << "---------------------------" << endl;
+	cout << NUM_SMALL_SORTS << " small sorts of " << SMALL_SORT_SIZE << " items on one thread:" << endl;
+	Report("Verified", all_sorted, failures);
+	Report("Permutation", all_permutations, failures);
+}
+
+// @ algorithm: quicksort or mergesort
+// @ input: Vector to sort
+// @ less_than: less<int>{} or greater<int>{}
+// @ failures: Number of failed checks so far
+// Function that cancels a sort part way, from inside its comparator so the point is the same
+// on every run, and checks that it stops, reports it, and leaves a permutation of the input
+template <typename Comparator>
+void CheckCancel(SortAlgorithm algorithm, const vector<int>& input, Comparator less_than, int& failures) {
+	vector<int> a = input;
+	SortPolicy policy;
+	policy.algorithm = algorithm;
+	SortStopToken stop = policy.stop;
+
+	SortFuture future = sortAsync(a, MakeTrigger(less_than, (long long)input.size(), [stop]() mutable { stop.requestStop(); }), policy);
+	const bool cancelled = ThrowsCancelled(future, SortStatus::Cancelled);
+
+	cout << "---------------------------" << endl;
+	cout << "Cancelled " << AlgorithmName(algorithm) << " (status " << StatusName(future.status())
+		<< ", progress " << future.progress() << "):" << endl;
+	Report("Cancelled", cancelled && future.status() == SortStatus::Cancelled, failures);
+	Report("Permutation", multisetChecksum(a) == multisetChecksum(input), failures);
+
+	// A sort cancelled before it starts never runs
+	vector<int> b = input;
+	SortPolicy stopped;
+	stopped.stop.requestStop();
+	SortFuture never = sortAsync(b, less_than, stopped);
+	Report("Cancelled before start", ThrowsCancelled(never, SortStatus::Cancelled) && b == input, failures);
+}
+
+// @ algorithm: quicksort or mergesort
+// @ input: Vector to sort
+// @ less_than: less<int>{} or greater<int>{}
+// @ failures: Number of failed checks so far
+// Function that gives a sort a deadline it cannot meet (its comparator stalls once part way)
+// and checks that it stops, reports it, and leaves a permutation of the input
+template <typename Comparator>
+void CheckDeadline(SortAlgorithm algorithm, const vector<int>& input, Comparator less_than, int& failures) {
+	vector<int> a = input;
+	SortPolicy policy;
+	policy.algorithm = algorithm;
+	policy.deadline = chrono::steady_clock::now() + chrono::milliseconds(200);
+
+	SortFuture future = sortAsync(a, MakeTrigger(less_than, (long long)input.size(), []() {
+		this_thread::sleep_for(chrono::milliseconds(300));
+	}), policy);
+	const bool expired = ThrowsCancelled(future, SortStatus::DeadlineExceeded);
+
+	cout << "---------------------------" << endl;
+	cout << "Deadline " << AlgorithmName(algorithm) << " (status " << StatusName(future.status()) << "):" << endl;
+	Report("Deadline exceeded", expired && future.status() == SortStatus::DeadlineExceeded, failures);
+	Report("Permutation", multisetChecksum(a) == multisetChecksum(input), failures);
+
+	// A deadline already past stops the sort before it starts
+	vector<int> b = input;
+	SortPolicy late;
+	late.deadline = chrono::steady_clock::now();
+	SortFuture never = sortAsync(b, less_than, late);
+	Report("Deadline passed before start", ThrowsCancelled(never, SortStatus::DeadlineExceeded) && b == input, failures);
+}
+
+// Function that returns true if get() rethrows the exception of the throwing comparator
+bool ThrowsComparatorFailure(const SortFuture& future) {
+	try {
+		future.get();
+	}
+	catch (const runtime_error& e) {
+		return string(e.what()) == "comparator failed";
+	}
+	return false;
+}
+
+// @ algorithm: quicksort or mergesort
+// @ input: Vector to sort
+// @ less_than: less<int>{} or greater<int>{}
+// @ failures: Number of failed checks so far
+// Function that checks that an exception thrown by the comparator reaches get(), and that the
+// vector is left a permutation of its input wherever the comparator throws: in median3, a
+// partition, an insertion sort or a merge. The first SMALL_SORT_SIZE items are sorted once
+// for each of their comparisons, with the comparator throwing on that one.
+template <typename Comparator>
+void CheckFailure(SortAlgorithm algorithm, const vector<int>& input, Comparator less_than, int& failures) {
+	const auto fail = []() { throw runtime_error("comparator failed"); };
+	SortPolicy policy;
+	policy.algorithm = algorithm;
+
+	vector<int> a = input;
+	SortFuture future = sortAsync(a, MakeTrigger(less_than, (long long)input.size(), fail), policy);
+	const bool rethrown = ThrowsComparatorFailure(future);
+
+	cout << "---------------------------" << endl;
+	cout << "Throwing comparator " << AlgorithmName(algorithm) << " (status " << StatusName(future.status()) << "):" << endl;
+	Report("Rethrown", rethrown && future.status() == SortStatus::Failed, failures);
+	Report("Permutation", multisetChecksum(a) == multisetChecksum(input), failures);
+
+	// Count the comparisons of the small sort, then throw on each of them in turn
+	const vector<int> small(input.begin(), input.begin() + SMALL_SORT_SIZE);
+	const MultisetChecksum small_checksum = multisetChecksum(small);
+	auto counter = MakeTrigger(less_than, 0, []() {});
+	vector<int> b = small;
+	sortAsync(b, counter, policy).get();
+	const long long comparisons = counter.calls->load();
+
+	bool all_rethrown = true, all_permutations = true;
+	for (long long trigger = 1; trigger <= comparisons; ++trigger) {
+		vector<int> c = small;
+		all_rethrown = ThrowsComparatorFailure(sortAsync(c, MakeTrigger(less_than, trigger, fail), policy)) && all_rethrown;
+		all_permutations = multisetChecksum(c) == small_checksum && all_permutations;
+	}
+	cout << "\tThrowing on each of " << comparisons << " comparisons of " << SMALL_SORT_SIZE << " items" << endl;
+	Report("Rethrown", all_rethrown, failures);
+	Report("Permutation", all_permutations, failures);
+}
+
+// Runs every check with the comparator @less_than and returns the number of failed checks
+template <typename Comparator>
+int RunChecks(const vector<int>& input, Comparator less_than) {
+	int failures = 0;
+	for (SortAlgorithm algorithm : { SortAlgorithm::Quicksort, SortAlgorithm::MergeSort }) {
+		CheckFinishedSort(algorithm, input, less_than, failures);
+		CheckCancel(algorithm, input, less_than, failures);
+		CheckDeadline(algorithm, input, less_than, failures);
+	}
+	CheckBatchedSorts(less_than, failures);
+	for (SortAlgorithm algorithm : { SortAlgorithm::Quicksort, SortAlgorithm::MergeSort })
+		CheckFailure(algorithm, input, less_than, failures);
+	return failures;
+}
+
+// Generates and returns random vector of size @size_of_vector.
+vector<int> GenerateRandomVector(size_t size_of_vector) {
+	vector<int> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back(rand());
+	return a;
+}
+
+// Generates and returns sorted vector of size @size_of_vector.
+vector<int> GenerateSortedVector(size_t size_of_vector) {
+	vector<int> a;
+	for (size_t i = 1; i <= size_of_vector; ++i)
+		a.push_back(i);
+	return a;
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc != 4) {
+		cout << "Usage: " << argv[0] << "<input_type> <input_size> <comparison_type>" << endl;
+		return 0;
+	}
+
+	const string input_type = string(argv[1]);
+	const int input_size = stoi(string(argv[2]));
+	const string comparison_type = string(argv[3]);
+
+	// Check to see if valid entry was entered
+	if (input_type != "random" && input_type != "sorted_small_to_large") {
+		cout << "Invalid input type" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered; the cancel checks stop the sort after input_size comparisons
+	if (input_size < 1000) {
+		cout << "Invalid size (at least 1000)" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (comparison_type != "less" && comparison_type != "greater") {
+		cout << "Invalid comparison type" << endl;
+		return 0;
+	}
+
+	cout << "Testing asynchronous sorts: " << input_type << " " << input_size << " numbers "
+		<< comparison_type << endl;
+
+	// Read the sort profile now, so the first timed sort does not
+	loadSortProfiles<int>();
+
+	const vector<int> input = input_type == "random" ? GenerateRandomVector(input_size) : GenerateSortedVector(input_size);
+	const int failures = comparison_type == "less" ? RunChecks(input, less<int>{}) : RunChecks(input, greater<int>{});
+
+	cout << "---------------------------" << endl;
+	cout << "Failed checks: " << failures << endl;
+	return failures == 0 ? 0 : 1;
+}
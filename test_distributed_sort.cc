@@ -0,0 +1,237 @@
+/*
+	This is the test_distributed_sort.cc file.
+	This code runs the distributed sort with several worker processes on one
+	machine, connected over Unix domain sockets or TCP on the loopback interface.
+	Each worker reports the time and bytes of every phase, and the workers check
+	together that the result is in order across all of them, and that it holds
+	the same items as the input (isSortedParallel and multisetChecksum, "SortVerify.h").
+	The few_unique input (4 distinct values) repeats splitters, whose copies must be
+	spread over several workers.
+*/
+
+#include "Sort.h"
+#include "DistributedSort.h"
+#include "SortVerify.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+// First TCP port; worker k listens on TCP_BASE_PORT + k
+const int TCP_BASE_PORT = 47000;
+
+// Passed down the chain of workers from rank 0 to the last rank
+struct ChainToken {
+	int64_t total_items;	// Items held by all lower ranks
+	int32_t has_last;		// Whether any lower rank holds an item
+	int32_t last;			// The largest item held by the lower ranks
+	int32_t verified;		// Whether every lower rank passed verification
+	int64_t max_items;		// Most items held by one of the lower ranks
+	MultisetChecksum input_checksum;	// Of the items the lower ranks generated
+	MultisetChecksum output_checksum;	// Of the items the lower ranks hold after the sort
+};
+
+// @ rank: The number of this worker
+// @ num_workers: The total number of workers
+// @ input_type: random, sorted_small_to_large or few_unique
+// @ first_item: The position of this worker's first item in the whole input
+// @ num_items: The number of items this worker generates
+// @ input_size: The number of items of all workers together
+// @ comparison_type: less or greater
+// @ transport_type: unix or tcp
+// @ socket_dir: Directory for the Unix domain sockets
+// Function run by each worker process. Generates the worker's share of the input, sorts it
+// with the other workers, and prints the per-phase statistics once every lower rank has printed.
+// Returns true if the worker's items are in order and in order with the lower ranks; the last
+// worker also checks that all workers together hold the items they generated.
+template <typename Comparator>
+bool RunWorker(int rank, int num_workers, const string& input_type, long long first_item, int num_items,
+	long long input_size, Comparator less_than, const string& transport_type, const string& socket_dir)
+{
+	unique_ptr<Transport> transport;
+	if (transport_type == "tcp") {
+		transport = connectTcpMesh(vector<string>(num_workers, "127.0.0.1"), TCP_BASE_PORT, rank);
+	}
+	else {
+		transport = connectUnixMesh(socket_dir, rank, num_workers);
+	}
+
+	// Generate this worker's share of the input
+	vector<int> a;
+	srand(rank + 1);
+	for (int i = 0; i < num_items; ++i) {
+		if (input_type == "random") {
+			a.push_back(rand());
+		}
+		else if (input_type == "few_unique") {
+			a.push_back(rand() % 4);
+		}
+		else {
+			a.push_back(int(first_item + i + 1));
+		}
+	}
+
+	const MultisetChecksum input_checksum = multisetChecksum(a);
+
+	DistributedSortStats stats = distributedSort(a, less_than, *transport);
+
+	// Wait for the lower ranks; they pass on their item count, their largest item and their checksums
+	ChainToken token = { 0, 0, 0, 1, 0, MultisetChecksum(), MultisetChecksum() };
+	if (rank > 0) {
+		transport->receive(rank - 1, &token, sizeof(token));
+	}
+
+	bool verified = isSortedParallel(a, less_than);
+	if (token.has_last && !a.empty() && less_than(a.front(), token.last)) {
+		verified = false;
+	}
+
+	ostringstream out;
+	out << "---------------------------" << endl;
+	out << "Worker " << rank << ": " << a.size() << " items" << endl;
+	out << "Sample:   " << int(stats.sampleSeconds * 1000) << "ms, "
+		<< stats.sampleBytesSent << " bytes sent, " << stats.sampleBytesReceived << " bytes received" << endl;
+	out << "Exchange: " << int(stats.exchangeSeconds * 1000) << "ms (local sort "
+		<< int(stats.sortSeconds * 1000) << "ms), " << stats.exchangeBytesSent << " bytes sent, "
+		<< stats.exchangeBytesReceived << " bytes received" << endl;
+	out << "Merge:    " << int(stats.mergeSeconds * 1000) << "ms" << endl;
+	out << "Verified: " << verified << endl;
+
+	token.total_items += a.size();
+	token.max_items = max(token.max_items, (int64_t)a.size());
+	token.verified = token.verified && verified;
+	token.input_checksum += input_checksum;
+	token.output_checksum += multisetChecksum(a);
+	if (!a.empty()) {
+		token.has_last = 1;
+		token.last = a.back();
+	}
+
+	if (rank == num_workers - 1) {
+		out << "---------------------------" << endl;
+		out << "Total items: " << token.total_items << endl;
+		out << "Most items on one worker: " << token.max_items << " (even share "
+			<< (input_size + num_workers - 1) / num_workers << ")" << endl;
+		const bool permutation = token.output_checksum == token.input_checksum;
+		out << "Permutation: " << permutation << endl;
+		if (token.total_items != input_size || !permutation) {
+			token.verified = false;
+			verified = false;
+		}
+		out << "All workers verified: " << token.verified << endl;
+	}
+	cout << out.str() << flush;
+
+	if (rank + 1 < num_workers) {
+		transport->send(rank + 1, &token, sizeof(token));
+	}
+
+	return verified;
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc < 4 || argc > 6) {
+		cout << "Usage: " << argv[0] << "<input_type> <input_size> <comparison_type> [num_workers] [unix|tcp]" << endl;
+		return 0;
+	}
+
+	const string input_type = string(argv[1]);
+	const int input_size = stoi(string(argv[2]));
+	const string comparison_type = string(argv[3]);
+	const int num_workers = argc > 4 ? stoi(string(argv[4])) : 4;
+	const string transport_type = argc > 5 ? string(argv[5]) : "unix";
+
+	// Check to see if valid entry was entered
+	if (input_type != "random" && input_type != "sorted_small_to_large" && input_type != "few_unique") {
+		cout << "Invalid input type" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (input_size <= 0) {
+		cout << "Invalid size" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (comparison_type != "less" && comparison_type != "greater") {
+		cout << "Invalid comparison type" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (num_workers <= 0 || (transport_type != "unix" && transport_type != "tcp")) {
+		cout << "Invalid worker count or transport" << endl;
+		return 0;
+	}
+
+	cout << "Testing distributed sort: " << input_type << " " << input_size << " numbers "
+		<< comparison_type << ", " << num_workers << " workers over " << transport_type << endl;
+
+	// Read the sort profile now, before the workers are forked, so their first timed sort does not
+	loadSortProfiles<int>();
+
+	// Directory for the Unix domain sockets
+	char socket_dir[] = "/tmp/distributed_sort.XXXXXX";
+	if (mkdtemp(socket_dir) == nullptr) {
+		cout << "Cannot create socket directory" << endl;
+		return 1;
+	}
+
+	// Start one process per worker. The items are split as evenly as possible;
+	// when they do not divide evenly, the last workers take one extra item each
+	const int base_items = input_size / num_workers;
+	const int first_extra = num_workers - input_size % num_workers;
+	vector<pid_t> workers;
+	for (int rank = 0; rank < num_workers; ++rank) {
+		const int num_items = base_items + (rank >= first_extra ? 1 : 0);
+		const long long first_item = (long long)rank * base_items + max(0, rank - first_extra);
+		pid_t pid = fork();
+		if (pid == 0) {
+			bool verified = false;
+			try {
+				if (comparison_type == "less") {
+					verified = RunWorker(rank, num_workers, input_type, first_item, num_items, input_size, less<int>{}, transport_type, socket_dir);
+				}
+				else {
+					verified = RunWorker(rank, num_workers, input_type, first_item, num_items, input_size, greater<int>{}, transport_type, socket_dir);
+				}
+			}
+			catch (const exception& e) {
+				cerr << "Worker " << rank << ": " << e.what() << endl;
+			}
+			_exit(verified ? 0 : 1);
+		}
+		workers.push_back(pid);
+	}
+
+	// Wait for all workers
+	bool all_ok = true;
+	for (pid_t pid : workers) {
+		int status = 0;
+		waitpid(pid, &status, 0);
+		all_ok = all_ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+
+	for (int rank = 0; rank < num_workers; ++rank) {
+		unlink((string(socket_dir) + "/worker" + to_string(rank) + ".sock").c_str());
+	}
+	rmdir(socket_dir);
+
+	return all_ok ? 0 : 1;
+}
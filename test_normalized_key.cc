@@ -0,0 +1,250 @@
+/*
+	This is the test_normalized_key.cc file.
+	This code sorts trade records on several columns (tenant ascending,
+	timestamp descending, price ascending with NaN last) by normalized key
+	("NormalizedKey.h"), and checks every result against std::stable_sort
+	with the same columns compared one by one.
+	The stable sort must give exactly the records std::stable_sort gives; the
+	unstable one the same keys in the same order, and the same records.
+	Each schema runs at the given size and at a size below
+	NORMALIZED_RADIX_CUTOFF, so both the radix sort and the comparison sort
+	of the keys are checked.
+*/
+
+#include "Sort.h"
+#include "NormalizedKey.h"
+#include "SortVerify.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Longest tenant name kept whole by the key of the first schema
+const int TENANT_PREFIX = 16;
+
+// Number of records of the run below NORMALIZED_RADIX_CUTOFF
+const int SMALL_SIZE = NORMALIZED_RADIX_CUTOFF / 4;
+
+// One trade; id is its position in the input
+struct Trade {
+	string tenant;
+	long long timestamp;
+	double price;
+	int region;
+	int quantity;
+	int id;
+};
+
+// Compares trades by tenant ascending, timestamp descending, then price ascending with NaN last
+struct TradeLess {
+	bool operator()(const Trade& x, const Trade& y) const {
+		if (x.tenant != y.tenant)
+			return x.tenant < y.tenant;
+		if (x.timestamp != y.timestamp)
+			return x.timestamp > y.timestamp;
+		if (isnan(x.price) || isnan(y.price))
+			return !isnan(x.price) && isnan(y.price);
+		return x.price < y.price;
+	}
+};
+
+// Compares trades by region descending, then quantity ascending
+struct RegionLess {
+	bool operator()(const Trade& x, const Trade& y) const {
+		if (x.region != y.region)
+			return x.region > y.region;
+		return x.quantity < y.quantity;
+	}
+};
+
+// Returns the schema of TradeLess; tenants longer than @tenant_prefix are compared on their prefix only
+KeySchema<Trade> TradeSchema(int tenant_prefix) {
+	KeySchema<Trade> schema;
+	schema.addString([](const Trade& t) -> const string& { return t.tenant; }, tenant_prefix)
+		.addInt([](const Trade& t) { return t.timestamp; }, KeyOrder::Descending)
+		.addFloat([](const Trade& t) { return t.price; }, KeyOrder::Ascending, NanOrder::Last);
+	return schema;
+}
+
+// Returns the schema of RegionLess, a key of 8 bytes
+KeySchema<Trade> RegionSchema() {
+	KeySchema<Trade> schema;
+	schema.addInt([](const Trade& t) { return t.region; }, KeyOrder::Descending)
+		.addInt([](const Trade& t) { return t.quantity; });
+	return schema;
+}
+
+// Hashes a trade by its id, so multisetChecksum tells whether a vector holds the same trades
+struct TradeHash {
+	unsigned long long operator()(const Trade& t) const { return (unsigned long long)t.id; }
+};
+
+// Returns true if @a holds trades with the same keys under @less_than as @expected, position by position
+template <typename Comparator>
+bool SameKeys(const vector<Trade>& a, const vector<Trade>& expected, Comparator less_than) {
+	if (a.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (less_than(a[i], expected[i]) || less_than(expected[i], a[i]))
+			return false;
+	return true;
+}
+
+// Returns true if @a holds the same trades as @expected, in the same order
+bool SameTrades(const vector<Trade>& a, const vector<Trade>& expected) {
+	if (a.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (a[i].id != expected[i].id)
+			return false;
+	return true;
+}
+
+// Generates and returns @size trades. Tenants are @tenant_length characters long and start
+// with @shared_prefix; few_unique draws every column from a handful of values, so most
+// records tie on their first columns. Some prices are NaN, -0.0 or 0.0.
+vector<Trade> GenerateTrades(const string& input_type, int size, int tenant_length, const string& shared_prefix) {
+	const int values = input_type == "few_unique" ? 4 : 1000;
+	vector<Trade> a;
+	for (int i = 0; i < size; ++i) {
+		Trade t;
+		t.tenant = shared_prefix;
+		while (int(t.tenant.size()) < tenant_length)
+			t.tenant += char('a' + rand() % (input_type == "few_unique" ? 2 : 26));
+		t.timestamp = (long long)(rand() % values) * 1000000007LL - 500000000000LL;
+		switch (rand() % 8) {
+		case 0: t.price = numeric_limits<double>::quiet_NaN(); break;
+		case 1: t.price = -0.0; break;
+		case 2: t.price = 0.0; break;
+		default: t.price = (rand() % values - values / 2) / 4.0; break;
+		}
+		t.region = rand() % values - values / 2;
+		t.quantity = rand() % values;
+		t.id = i;
+		a.push_back(t);
+	}
+	return a;
+}
+
+// @ check: What was checked
+// @ passed: Whether it held
+// @ failures: Number of failed checks so far
+// Function that prints one check and counts it if it failed
+void Report(const string& check, bool passed, int& failures) {
+	cout << check << ": " << passed << endl;
+	if (!passed)
+		++failures;
+}
+
+// @ name: Name of the case
+// @ input: Trades to sort
+// @ schema: The columns of @less_than, as a KeySchema
+// @ less_than: The same columns compared one by one
+// @ failures: Number of failed checks so far
+// Function that sorts @input by normalized key, stable and not, checks both against
+// std::stable_sort with @less_than, and prints the runtimes
+template <typename Comparator>
+void CheckSchema(const string& name, const vector<Trade>& input, const KeySchema<Trade>& schema,
+	Comparator less_than, int& failures) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	const MultisetChecksum input_checksum = multisetChecksum(input, TradeHash());
+
+	vector<Trade> expected = input;
+	auto begin = Time::now();
+	std::stable_sort(expected.begin(), expected.end(), less_than);
+	auto end = Time::now();
+
+	cout << "---------------------------" << endl;
+	cout << name << " (" << input.size() << " records, key of " << schema.width() << " bytes):" << endl;
+	cout << "std::stable_sort, column comparator: "
+		<< chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+
+	vector<Trade> stable = input;
+	begin = Time::now();
+	sortByNormalizedKey(stable, schema, true);
+	end = Time::now();
+	cout << "sortByNormalizedKey, stable: " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+	Report("Same records as std::stable_sort", SameTrades(stable, expected), failures);
+
+	vector<Trade> unstable = input;
+	begin = Time::now();
+	sortByNormalizedKey(unstable, schema);
+	end = Time::now();
+	cout << "sortByNormalizedKey: " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+	Report("Verified", isSortedParallel(unstable, less_than), failures);
+	Report("Same keys as std::stable_sort", SameKeys(unstable, expected, less_than), failures);
+	Report("Permutation", multisetChecksum(unstable, TradeHash()) == input_checksum, failures);
+}
+
+// @ input: Trades whose tenants are longer than the key's prefix and share its first bytes
+// @ failures: Number of failed checks so far
+// Function that sorts @input by a key holding only part of each tenant, breaking ties with
+// TradeLess, and checks the result against std::stable_sort with TradeLess
+void CheckTieBreak(const vector<Trade>& input, int& failures) {
+	const KeySchema<Trade> schema = TradeSchema(TENANT_PREFIX / 2);
+	vector<Trade> expected = input;
+	std::stable_sort(expected.begin(), expected.end(), TradeLess());
+
+	vector<Trade> a = input;
+	sortByNormalizedKey(a, schema, TradeLess());
+
+	cout << "---------------------------" << endl;
+	cout << "Tenants longer than the key prefix, tie-break comparator (" << input.size() << " records):" << endl;
+	Report("Verified", isSortedParallel(a, TradeLess()), failures);
+	Report("Same keys as std::stable_sort", SameKeys(a, expected, TradeLess()), failures);
+	Report("Permutation", multisetChecksum(a, TradeHash()) == multisetChecksum(input, TradeHash()), failures);
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc != 3) {
+		cout << "Usage: " << argv[0] << "<input_type> <input_size>" << endl;
+		return 0;
+	}
+
+	const string input_type = string(argv[1]);
+	const int input_size = stoi(string(argv[2]));
+
+	// Check to see if valid entry was entered
+	if (input_type != "random" && input_type != "few_unique") {
+		cout << "Invalid input type" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (input_size <= 0) {
+		cout << "Invalid size" << endl;
+		return 0;
+	}
+
+	cout << "Testing normalized key sorts: " << input_type << " " << input_size << " records" << endl;
+
+	// Read the sort profile now, so the first timed sort does not
+	loadSortProfiles<Trade, NormalizedKeyRef>();
+
+	int failures = 0;
+	for (int size : { input_size, min(input_size, SMALL_SIZE) }) {
+		const vector<Trade> input = GenerateTrades(input_type, size, TENANT_PREFIX, "");
+		CheckSchema("tenant, timestamp descending, price", input, TradeSchema(TENANT_PREFIX), TradeLess(), failures);
+		CheckSchema("region descending, quantity", input, RegionSchema(), RegionLess(), failures);
+		CheckTieBreak(GenerateTrades(input_type, size, TENANT_PREFIX + 4, "tenant/"), failures);
+	}
+
+	cout << "---------------------------" << endl;
+	cout << "Failed checks: " << failures << endl;
+	return failures == 0 ? 0 : 1;
+}
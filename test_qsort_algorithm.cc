@@ -4,12 +4,13 @@
 
 	This is the test_qsort_algorithm.cc file for Part(2) of the assignment.
 	This code tests variations of the quicksort algorithm which include, median of three, 
-	middle pivot, and first pivot. 
+	middle pivot, and first pivot, and the iterative, dual-pivot and three-pivot quicksorts. 
 
 	
 */
 
 #include "Sort.h"
+#include "SortVerify.h"
 #include <chrono>
 #include <iostream>
 #include <fstream>
@@ -24,28 +25,8 @@ namespace {
 template <typename Comparable, typename Comparator>
 bool VerifyOrder(const vector<Comparable>& input, Comparator less_than) {
 
-	// Checks to see if vector size is >= 2. If it is not, then there is nothing to compare
-	if (input.size() >= 2) {
-
-		// Check all adjacent elements to see if they're in the right order
-		for (unsigned int i = 0; i < input.size() - 1; i++) {
-			// if the current index is (<=) or (>=) to the next index, then it is in order; move to the next value
-			// using (<=) or (>=) to check depends on what the user specifies for the less_than variable
-			if (!less_than(input[i + 1], input[i])) {
-				continue;
-			}
-			// if the current index is not (<=) or (>=) to the next index, then it is not in the correct order. 
-			// Using (<=) or (>=) to check depends on what the user specifies for the less_than variable
-			else {
-				return false;
-			}
-		}
-
-	}
-	
-	// If the vector size is less than 2, then it can't be sorted/ Already sorted with one element 
-	// If no errors were found, the vector is in sorted order; return true
-	return true;
+	// Check all adjacent elements on every core, a few at a time with SIMD for int and double (see SortVerify.h)
+	return isSortedParallel(input, less_than);
 }
 
 // Quicksort implementation using the median of three as a pivot
@@ -66,15 +47,35 @@ void QuickSortFirst(vector<Comparable>& a, Comparator less_than) {
 	quicksortFirst(a, less_than, 0, a.size());
 }
 
+// Quicksort implementation using the median of three as a pivot and an explicit stack instead of recursion
+template <typename Comparable, typename Comparator>
+void QuickSortIterative(vector<Comparable>& a, Comparator less_than) {
+	quicksortIterative(a, less_than);
+}
+
+// Quicksort implementation using two pivots from a sorted sample of five values
+template <typename Comparable, typename Comparator>
+void QuickSortDualPivot(vector<Comparable>& a, Comparator less_than) {
+	multiPivotQuicksort(a, less_than, 2);
+}
+
+// Quicksort implementation using three pivots from a sorted sample of seven values
+template <typename Comparable, typename Comparator>
+void QuickSortThreePivot(vector<Comparable>& a, Comparator less_than) {
+	multiPivotQuicksort(a, less_than, 3);
+}
+
 // @ sort_type: The type of sorting method that's going to be used 
 // @ test_vector_: Vector that needs to be sorted
 // @ comparison_type: less<int>{} or greater<int>{}
 // @ begin: The start time of the code
 // @ end: the end time of the code 
+// @ input_checksum: multisetChecksum() of the vector before it was sorted
 // Function that prints out the amount of time it takes one sorting algorithm to run. 
-// It also verifies the sorted order of the resulting vector 
+// It also verifies the sorted order of the resulting vector, and that it holds the same items as before
 template <typename Clock>
-void printDurationAndVerify(const string& sort_type, vector<int>& test_vector_, const string& comparison_type, const Clock& begin, const Clock& end)
+void printDurationAndVerify(const string& sort_type, vector<int>& test_vector_, const string& comparison_type, const Clock& begin, const Clock& end,
+	const MultisetChecksum& input_checksum)
 {
 	cout << "---------------------------" << endl;
 	cout << sort_type << ":\nRuntime: ";
@@ -90,6 +91,9 @@ void printDurationAndVerify(const string& sort_type, vector<int>& test_vector_,
 	else if (comparison_type == "greater") {
 		cout << "Verified: " << VerifyOrder(test_vector_, greater<int>{}) << endl;
 	}
+
+	// No item was lost or duplicated by the sort
+	cout << "Permutation: " << (multisetChecksum(test_vector_) == input_checksum) << endl;
 }
 
 // @ sort_type: The type of sorting method that's going to be used 
@@ -102,6 +106,9 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
 	typedef chrono::high_resolution_clock Time; 
 
+	// Summarize the items before sorting, to check afterwards that none were lost or duplicated
+	const MultisetChecksum input_checksum = multisetChecksum(test_vector_);
+
 	// Check to see which type of sorting method is used
 	if (sort_type == "Median of three") {
 		// Checks to see which type of sorted order the vector needs to be sorted in (less, greater) 
@@ -112,7 +119,7 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 			// End of piece of code to time
 			const auto end = Time::now(); 
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end); 
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum); 
 		}
 
 		else if (comparison_type == "greater") {
@@ -122,7 +129,7 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else {
@@ -140,7 +147,7 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else if (comparison_type == "greater") {
@@ -150,7 +157,7 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else {
@@ -168,7 +175,7 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else if (comparison_type == "greater") {
@@ -178,7 +185,91 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else {
+			cout << "Invalid Comparison type. Please use 'less' or 'greater'";
+			return;
+		}
+	}
+
+	else if (sort_type == "Iterative") {
+		// Checks to see which type of sorted order the vector needs to be sorted in (less, greater) 
+		if (comparison_type == "less") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			QuickSortIterative(test_vector_, less<int>{}); 
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else if (comparison_type == "greater") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			QuickSortIterative(test_vector_, greater<int>{});
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else {
+			cout << "Invalid Comparison type. Please use 'less' or 'greater'";
+			return;
+		}
+	}
+
+	else if (sort_type == "Dual pivot") {
+		// Checks to see which type of sorted order the vector needs to be sorted in (less, greater) 
+		if (comparison_type == "less") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			QuickSortDualPivot(test_vector_, less<int>{}); 
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else if (comparison_type == "greater") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			QuickSortDualPivot(test_vector_, greater<int>{});
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else {
+			cout << "Invalid Comparison type. Please use 'less' or 'greater'";
+			return;
+		}
+	}
+
+	else if (sort_type == "Three pivot") {
+		// Checks to see which type of sorted order the vector needs to be sorted in (less, greater) 
+		if (comparison_type == "less") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			QuickSortThreePivot(test_vector_, less<int>{}); 
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else if (comparison_type == "greater") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			QuickSortThreePivot(test_vector_, greater<int>{});
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else {
@@ -188,7 +279,7 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 	}
 
 	else {
-		cout << "Invalid Sort Type. Please retry using quick_median, quick_middle, or quick_first" << endl;
+		cout << "Invalid Sort Type. Please retry using quick_median, quick_middle, quick_first, quick_iterative, quick_dual_pivot, or quick_three_pivot" << endl;
 		return;
 	}
 }
@@ -266,6 +357,9 @@ int main(int argc, char** argv) {
 	cout << "Testing quicksort: " << input_type << " " << input_size << " numbers " 
 		<< comparison_type << endl;
 
+	// Read the sort profile now, so the first timed sort does not
+	loadSortProfiles<int>();
+
 	// Generate and fill vector based on user input
 	vector<int> input_vector;
 
@@ -280,16 +374,28 @@ int main(int argc, char** argv) {
 	vector<int> quicksort_median_vector_ = input_vector;
 	vector<int> quicksort_middle_vector_ = input_vector;
 	vector<int> quicksort_first_vector_ = input_vector;
-	string quick_median = "Median of three", quick_middle = "Middle", quick_first = "First";
+	vector<int> quicksort_iterative_vector_ = input_vector;
+	vector<int> quicksort_dual_pivot_vector_ = input_vector;
+	vector<int> quicksort_three_pivot_vector_ = input_vector;
+	string quick_median = "Median of three", quick_middle = "Middle", quick_first = "First", quick_iterative = "Iterative";
+	string quick_dual_pivot = "Dual pivot", quick_three_pivot = "Three pivot";
 
-	// Use all three quicksort sorting methods (median of three, middle, first) 
+	// Use all six quicksort sorting methods (median of three, middle, first, iterative, dual pivot, three pivot) 
 	// and sort the generated vector based on user input. 
 	// Time all these sorting methods and display the amount of time taken to complete each method
 	// along with if it is sorted properly or not (Verification status). 
 	SortAndTestTiming(quick_median, quicksort_median_vector_, comparison_type);
 	SortAndTestTiming(quick_middle, quicksort_middle_vector_, comparison_type);
 	SortAndTestTiming(quick_first, quicksort_first_vector_, comparison_type);
-
+	SortAndTestTiming(quick_iterative, quicksort_iterative_vector_, comparison_type);
+	SortAndTestTiming(quick_dual_pivot, quicksort_dual_pivot_vector_, comparison_type);
+	SortAndTestTiming(quick_three_pivot, quicksort_three_pivot_vector_, comparison_type);
+
+#ifdef SORT_TRACE
+	// Save the timeline of the sorts above; open it in Perfetto (ui.perfetto.dev)
+	if (writeSortTrace(string("sort_trace.json")))
+		cout << "Trace written to sort_trace.json" << endl;
+#endif
 
 	return 0;
 }
@@ -0,0 +1,178 @@
+/*
+	This is the test_sample_sort.cc file.
+	This code times the parallel sample sort with 1 up to all hardware threads,
+	and reports its speedup over the single-threaded quicksort.
+	Every result is checked for order, and for holding the same items as the input,
+	with isSortedParallel and multisetChecksum ("SortVerify.h").
+	The few_unique input (16 distinct values) exercises the equality buckets.
+*/
+
+#include "Sort.h"
+#include "SampleSort.h"
+#include "SortVerify.h"
+#include <chrono>
+#include <iostream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// @ sort_type: The name of the sorting method that was used
+// @ test_vector_: Vector that was sorted
+// @ comparison_type: less<int>{} or greater<int>{}
+// @ nanoseconds: The runtime of the sorting method
+// @ baseline_nanoseconds: The runtime of quicksort, used to compute the speedup
+// @ input_checksum: multisetChecksum() of the vector before it was sorted
+// Function that prints out the runtime and speedup of one run, and verifies the sorted order
+// and that the vector holds the same items as before
+void printDurationAndVerify(const string& sort_type, const vector<int>& test_vector_, const string& comparison_type,
+	long long nanoseconds, long long baseline_nanoseconds, const MultisetChecksum& input_checksum)
+{
+	cout << "---------------------------" << endl;
+	cout << sort_type << ":\nRuntime: ";
+	cout << nanoseconds << "ns" << ", " << nanoseconds / 1000000 << "ms" << endl;
+	cout << "Speedup vs quicksort: " << double(baseline_nanoseconds) / (nanoseconds > 0 ? nanoseconds : 1) << endl;
+
+	// Verify the sorted order of the vector based on the comparison_type variable
+	if (comparison_type == "less") {
+		cout << "Verified: " << isSortedParallel(test_vector_, less<int>{}) << endl;
+	}
+	else if (comparison_type == "greater") {
+		cout << "Verified: " << isSortedParallel(test_vector_, greater<int>{}) << endl;
+	}
+
+	// No item was lost or duplicated by the sort
+	cout << "Permutation: " << (multisetChecksum(test_vector_) == input_checksum) << endl;
+}
+
+// @ num_threads: Number of threads for sample sort, or 0 to use quicksort
+// @ test_vector_: Vector that needs to be sorted
+// @ comparison_type: less<int>{} or greater<int>{}
+// Function that sorts the vector and returns the runtime in nanoseconds
+long long SortAndTime(int num_threads, vector<int>& test_vector_, const string& comparison_type)
+{
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	const auto begin = Time::now();
+	if (comparison_type == "less") {
+		if (num_threads == 0)
+			quicksort(test_vector_, less<int>{});
+		else
+			sampleSort(test_vector_, less<int>{}, num_threads);
+	}
+	else {
+		if (num_threads == 0)
+			quicksort(test_vector_, greater<int>{});
+		else
+			sampleSort(test_vector_, greater<int>{}, num_threads);
+	}
+	const auto end = Time::now();
+
+	return chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+}
+
+// Generates and returns random vector of size @size_of_vector.
+vector<int> GenerateRandomVector(size_t size_of_vector) {
+	vector<int> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back(rand());
+	return a;
+}
+
+// Generates and returns a vector of size @size_of_vector holding only 16 distinct values.
+vector<int> GenerateFewUniqueVector(size_t size_of_vector) {
+	vector<int> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back(rand() % 16);
+	return a;
+}
+
+// Generates and returns sorted vector of size @size_of_vector.
+vector<int> GenerateSortedVector(size_t size_of_vector) {
+	vector<int> a;
+	for (size_t i = 1; i <= size_of_vector; ++i)
+		a.push_back(i);
+	return a;
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc != 4) {
+		cout << "Usage: " << argv[0] << "<input_type> <input_size> <comparison_type>" << endl;
+		return 0;
+	}
+
+	const string input_type = string(argv[1]);
+	const int input_size = stoi(string(argv[2]));
+	const string comparison_type = string(argv[3]);
+
+	// Check to see if valid entry was entered
+	if (input_type != "random" && input_type != "sorted_small_to_large" && input_type != "few_unique") {
+		cout << "Invalid input type" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (input_size <= 0) {
+		cout << "Invalid size" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (comparison_type != "less" && comparison_type != "greater") {
+		cout << "Invalid comparison type" << endl;
+		return 0;
+	}
+
+	int max_threads = thread::hardware_concurrency();
+	if (max_threads <= 0)
+		max_threads = 1;
+
+	cout << "Testing sample sort: " << input_type << " " << input_size << " numbers "
+		<< comparison_type << ", 1 to " << max_threads << " threads" << endl;
+
+	// Read the sort profile now, so the first timed sort does not
+	loadSortProfiles<int>();
+
+	vector<int> input_vector;
+	if (input_type == "random") {
+		input_vector = GenerateRandomVector(input_size);
+	}
+	else if (input_type == "few_unique") {
+		input_vector = GenerateFewUniqueVector(input_size);
+	}
+	else {
+		input_vector = GenerateSortedVector(input_size);
+	}
+
+	const MultisetChecksum input_checksum = multisetChecksum(input_vector);
+
+	// Time quicksort once as the baseline
+	vector<int> quicksort_test_vector_ = input_vector;
+	const long long baseline = SortAndTime(0, quicksort_test_vector_, comparison_type);
+	printDurationAndVerify("quicksort", quicksort_test_vector_, comparison_type, baseline, baseline, input_checksum);
+
+	// Time sample sort from one thread up to all hardware threads
+	for (int num_threads = 1; num_threads <= max_threads; ++num_threads) {
+		vector<int> samplesort_test_vector_ = input_vector;
+		const long long runtime = SortAndTime(num_threads, samplesort_test_vector_, comparison_type);
+		printDurationAndVerify("sample sort (" + to_string(num_threads) + " threads)",
+			samplesort_test_vector_, comparison_type, runtime, baseline, input_checksum);
+	}
+
+#ifdef SORT_TRACE
+	// Save the timeline of the sorts above; open it in Perfetto (ui.perfetto.dev)
+	if (writeSortTrace(string("sort_trace.json")))
+		cout << "Trace written to sort_trace.json" << endl;
+#endif
+
+	return 0;
+}
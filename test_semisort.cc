@@ -0,0 +1,133 @@
+/*
+	This is the test_semisort.cc file.
+	This code groups records by key with semisort ("Semisort.h") and checks that
+	the result is a valid grouping: every group holds equal keys, no two groups
+	hold equal keys, and the records are the same as before.
+	Keys are int64, double and string. A tenth of the double keys are -0.0 or 0.0,
+	which compare equal, so they must end up in one group. With few_unique keys the
+	common ones get buckets of their own (heavy keys); with random keys every key
+	goes through the light buckets.
+*/
+
+#include "Sort.h"
+#include "Semisort.h"
+#include "SortVerify.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// A record to group; id is its position in the input
+template <typename Key>
+struct Record {
+	Key key;
+	int id;
+};
+
+// Hashes a record by its id, so multisetChecksum tells whether a vector holds the same records
+struct RecordIdHash {
+	template <typename Key>
+	unsigned long long operator()(const Record<Key>& r) const { return (unsigned long long)r.id; }
+};
+
+// Returns true if @bounds splits @a into groups of equal keys, with no key in two groups,
+// and @a holds the records of @input
+template <typename Key>
+bool ValidGroups(const vector<Record<Key>>& a, const vector<int>& bounds, const vector<Record<Key>>& input) {
+	if (bounds.empty() || bounds.front() != 0 || bounds.back() != int(a.size()))
+		return false;
+	vector<Key> keys;
+	for (size_t g = 0; g + 1 < bounds.size(); ++g) {
+		if (bounds[g] >= bounds[g + 1])
+			return false;
+		for (int i = bounds[g]; i < bounds[g + 1]; ++i)
+			if (!(a[i].key == a[bounds[g]].key))
+				return false;
+		keys.push_back(a[bounds[g]].key);
+	}
+
+	// Equal keys are next to each other once sorted, -0.0 and 0.0 included
+	std::sort(keys.begin(), keys.end());
+	return adjacent_find(keys.begin(), keys.end()) == keys.end() &&
+		multisetChecksum(a, RecordIdHash()) == multisetChecksum(input, RecordIdHash());
+}
+
+// Returns the key of record @i of @size: one of 8 values if @few_unique, else one of @size values
+long long Int64Key(int i, int size, bool few_unique) {
+	return (long long)(rand() % (few_unique ? 8 : size)) * 1000003LL - 500000000LL;
+}
+
+double DoubleKey(int i, int size, bool few_unique) {
+	if (rand() % 10 == 0)
+		return rand() % 2 == 0 ? -0.0 : 0.0;
+	return (rand() % (few_unique ? 8 : size) - (few_unique ? 4 : size / 2)) / 4.0;
+}
+
+string StringKey(int i, int size, bool few_unique) {
+	return "key" + to_string(rand() % (few_unique ? 8 : size));
+}
+
+// @ type_name: The name of the key type, for the report
+// @ key: Function that returns the key of a record
+// @ input_type: random or few_unique
+// @ input_size: Number of records
+// @ failures: Number of failed checks so far
+// Function that groups records with keys from @key and checks the groups
+template <typename Key>
+void CheckGroups(const string& type_name, Key (*key)(int, int, bool), const string& input_type, int input_size, int& failures) {
+	vector<Record<Key>> input;
+	for (int i = 0; i < input_size; ++i)
+		input.push_back(Record<Key>{ key(i, input_size, input_type == "few_unique"), i });
+
+	const int num_threads = max(1u, thread::hardware_concurrency());
+	vector<Record<Key>> a = input;
+	const vector<int> bounds = semisort(a, [](const Record<Key>& r) { return r.key; }, num_threads);
+
+	const bool valid = ValidGroups(a, bounds, input);
+	cout << type_name << " keys: " << bounds.size() - 1 << " groups, valid: " << valid << endl;
+	if (!valid)
+		++failures;
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc != 3) {
+		cout << "Usage: " << argv[0] << "<input_type> <input_size>" << endl;
+		return 0;
+	}
+
+	const string input_type = string(argv[1]);
+	const int input_size = stoi(string(argv[2]));
+
+	// Check to see if valid entry was entered
+	if (input_type != "random" && input_type != "few_unique") {
+		cout << "Invalid input type" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (input_size <= 0) {
+		cout << "Invalid size" << endl;
+		return 0;
+	}
+
+	cout << "Testing semisort: " << input_type << " " << input_size << " records" << endl;
+
+	int failures = 0;
+	CheckGroups<long long>("int64", Int64Key, input_type, input_size, failures);
+	CheckGroups<double>("double", DoubleKey, input_type, input_size, failures);
+	CheckGroups<string>("string", StringKey, input_type, input_size, failures);
+
+	cout << "---------------------------" << endl;
+	cout << "Failed checks: " << failures << endl;
+	return failures == 0 ? 0 : 1;
+}
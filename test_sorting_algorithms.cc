@@ -7,6 +7,10 @@
 */
 
 #include "Sort.h"
+#include "StringSort.h"
+#include "SortDispatch.h"
+#include "SortVerify.h"
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <fstream>
@@ -21,28 +25,8 @@ namespace {
 template <typename Comparable, typename Comparator>
 bool VerifyOrder(const vector<Comparable> &input, Comparator less_than) {
 
-	// Checks to see if vector size is >= 2. If it is not, then there is nothing to compare
-	if (input.size() >= 2) {
-
-		// Check all adjacent elements to see if they're in the right order
-		for (unsigned int i = 0; i < input.size() - 1; i++) {
-			// if the current index is (<=) or (>=) to the next index, then it is in order; move to the next value
-			// using (<=) or (>=) to check depends on what the user specifies for the less_than variable
-			if (!less_than(input[i+1], input[i])) {
-				continue;
-			}
-			// if the current index is not (<=) or (>=) to the next index, then it is not in the correct order. 
-			// Using (<=) or (>=) to check depends on what the user specifies for the less_than variable
-			else {
-				return false;
-			}
-		}
-
-	}
-
-	// If the vector size is less than 2, then it can't be sorted/ Already sorted with one element 
-	// If no errors were found, the vector is in sorted order; return true
-	return true;
+	// Check all adjacent elements on every core, a few at a time with SIMD for int and double (see SortVerify.h)
+	return isSortedParallel(input, less_than);
 }
 
 // @ sort_type: The type of sorting method that's going to be used (quicksort, mergesort, heapsort)
@@ -50,10 +34,12 @@ bool VerifyOrder(const vector<Comparable> &input, Comparator less_than) {
 // @ comparison_type: less<int>{} or greater<int>{}
 // @ begin: The start time of the code
 // @ end: the end time of the code 
+// @ input_checksum: multisetChecksum() of the vector before it was sorted
 // Function that prints out the amount of time it takes one sorting algorithm to run. 
-// It also verifies the sorted order of the resulting vector 
-template <typename Clock>
-void printDurationAndVerify(const string& sort_type, vector<int>& test_vector_, const string& comparison_type, const Clock& begin, const Clock& end)
+// It also verifies the sorted order of the resulting vector, and that it holds the same items as before
+template <typename Clock, typename Comparable>
+void printDurationAndVerify(const string& sort_type, vector<Comparable>& test_vector_, const string& comparison_type, const Clock& begin, const Clock& end,
+	const MultisetChecksum& input_checksum)
 {
 	cout << "---------------------------------------------------------------" << endl;
 	cout << sort_type << ":\tRuntime: ";
@@ -64,11 +50,14 @@ void printDurationAndVerify(const string& sort_type, vector<int>& test_vector_,
 
 	// Verify the sorted order of the vector based on the comparison_type variable 
 	if (comparison_type == "less") {
-		cout << "\t\tVerified: " << VerifyOrder(test_vector_, less<int>{}) << endl;
+		cout << "\t\tVerified: " << VerifyOrder(test_vector_, less<Comparable>{}) << endl;
 	}
 	else if (comparison_type == "greater") {
-		cout << "\t\tVerified: " << VerifyOrder(test_vector_, greater<int>{}) << endl;
+		cout << "\t\tVerified: " << VerifyOrder(test_vector_, greater<Comparable>{}) << endl;
 	}
+
+	// No item was lost or duplicated by the sort
+	cout << "\t\tPermutation: " << (multisetChecksum(test_vector_) == input_checksum) << endl;
 }
 
 // @ sort_type: The type of sorting method that's going to be used (quicksort, mergesort, heapsort)
@@ -76,32 +65,36 @@ void printDurationAndVerify(const string& sort_type, vector<int>& test_vector_,
 // @ comparison_type: less<int>{} or greater<int>{}
 // Function that tests how long a specified sorting algorthm takes to run while sorting it based on the user preference
 // Calls the function printDurationAndVerify() to output the data computed and to verify of the vector is in the correct sorted order
-void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const string& comparison_type) {
+template <typename Comparable>
+void SortAndTestTiming(const string& sort_type, vector<Comparable>& test_vector_, const string& comparison_type) {
 
 	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
 	typedef chrono::high_resolution_clock Time;
 
+	// Summarize the items before sorting, to check afterwards that none were lost or duplicated
+	const MultisetChecksum input_checksum = multisetChecksum(test_vector_);
+
 	// Check to see which type of sorting method is used
 	if (sort_type == "quicksort") {
 		// Checks to see which type of sorted order the vector needs to be sorted in (less, greater) 
 		if (comparison_type == "less") {
 			// start of piece of code to time
 			const auto begin = Time::now();
-			quicksort(test_vector_, less<int>{});
+			quicksort(test_vector_, less<Comparable>{});
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else if (comparison_type == "greater") {
 			// start of piece of code to time
 			const auto begin = Time::now();
-			quicksort(test_vector_, greater<int>{});
+			quicksort(test_vector_, greater<Comparable>{});
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else { cout << "Invalid Comparison type. Please use 'less' or 'greater'"; return; }
@@ -112,21 +105,21 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 		if (comparison_type == "less") {
 			// start of piece of code to time
 			const auto begin = Time::now();
-			mergeSort(test_vector_, less<int>{});
+			mergeSort(test_vector_, less<Comparable>{});
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else if (comparison_type == "greater") {
 			// start of piece of code to time
 			const auto begin = Time::now();
-			mergeSort(test_vector_, greater<int>{});
+			mergeSort(test_vector_, greater<Comparable>{});
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 		}
 
 		else { cout << "Invalid Comparison type. Please use 'less' or 'greater'"; return; }
@@ -137,31 +130,107 @@ void SortAndTestTiming(const string& sort_type, vector<int>& test_vector_, const
 		if (comparison_type == "less") {
 			// start of piece of code to time
 			const auto begin = Time::now();
-			heapsort(test_vector_, less<int>{});
+			heapsort(test_vector_, less<Comparable>{});
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else if (comparison_type == "greater") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			heapsort(test_vector_, greater<Comparable>{});
+			// End of piece of code to time
+			const auto end = Time::now();
+			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+		}
+
+		else { cout << "Invalid Comparison type. Please use 'less' or 'greater'"; return; }
+	}
+
+	else if (sort_type == "adaptive sort") {
+		// Checks to see which type of sorted order the vector needs to be sorted in (less, greater) 
+		if (comparison_type == "less") {
+			// start of piece of code to time
+			const auto begin = Time::now();
+			const SortDecision decision = sort(test_vector_, less<Comparable>{});
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+			// Print which sorting algorithm was picked, and why
+			cout << "\t\tDecision: " << decision << endl;
 		}
 
 		else if (comparison_type == "greater") {
 			// start of piece of code to time
 			const auto begin = Time::now();
-			heapsort(test_vector_, greater<int>{});
+			const SortDecision decision = sort(test_vector_, greater<Comparable>{});
 			// End of piece of code to time
 			const auto end = Time::now();
 			// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
-			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end);
+			printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
+			// Print which sorting algorithm was picked, and why
+			cout << "\t\tDecision: " << decision << endl;
 		}
 
 		else { cout << "Invalid Comparison type. Please use 'less' or 'greater'"; return; }
 	}
 
 	else {
-		cout << "Invalid Sort Type. Please retry using quicksort, mergesort, or heapsort" << endl;
+		cout << "Invalid Sort Type. Please retry using quicksort, mergesort, heapsort, or adaptive sort" << endl;
+		return;
+	}
+
+}
+
+// @ sort_type: The type of string sorting method that's going to be used (multikey quicksort, msd radix sort, lcp mergesort)
+// @ test_vector_: Vector of strings that needs to be sorted
+// @ comparison_type: less or greater
+// Function that tests how long a specified string sorting algorithm takes to run.
+// The string sorts only sort smallest first, so for greater the result is reversed (inside the timed code).
+// Calls the function printDurationAndVerify() to output the data computed and to verify of the vector is in the correct sorted order
+void SortStringsAndTestTiming(const string& sort_type, vector<string>& test_vector_, const string& comparison_type) {
+
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	if (comparison_type != "less" && comparison_type != "greater") {
+		cout << "Invalid Comparison type. Please use 'less' or 'greater'";
+		return;
+	}
+
+	// Summarize the items before sorting, to check afterwards that none were lost or duplicated
+	const MultisetChecksum input_checksum = multisetChecksum(test_vector_);
+
+	// start of piece of code to time
+	const auto begin = Time::now();
+
+	// Check to see which type of string sorting method is used
+	if (sort_type == "multikey quicksort") {
+		multikeyQuicksort(test_vector_);
+	}
+	else if (sort_type == "msd radix sort") {
+		msdRadixSort(test_vector_);
+	}
+	else if (sort_type == "lcp mergesort") {
+		lcpMergeSort(test_vector_);
+	}
+	else {
+		cout << "Invalid Sort Type. Please retry using multikey quicksort, msd radix sort, or lcp mergesort" << endl;
 		return;
 	}
 
+	if (comparison_type == "greater") {
+		reverse(test_vector_.begin(), test_vector_.end());
+	}
+
+	// End of piece of code to time
+	const auto end = Time::now();
+	// Calls function to verify the order, calculate and print the time duration for the sorting algorithm
+	printDurationAndVerify(sort_type, test_vector_, comparison_type, begin, end, input_checksum);
 }
 
 // Generates and returns random vector of size @size_of_vector.
@@ -180,6 +249,26 @@ vector<int> GenerateSortedVector(size_t size_of_vector) {
 	return a;
 }
 
+// Generates and returns a vector of @size_of_vector random URL-like strings.
+// The strings share long common prefixes (host and path), like real URLs and symbol names.
+vector<string> GenerateRandomStrings(size_t size_of_vector) {
+	const string hosts[] = { "https://www.example.com/", "https://www.example.org/", "https://api.example.com/v2/" };
+	const string paths[] = { "catalog/products/", "catalog/categories/", "users/profile/", "orders/history/" };
+	vector<string> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back(hosts[rand() % 3] + paths[rand() % 4] + to_string(rand() % 100000) + "/" + to_string(rand()));
+	return a;
+}
+
+
+// Writes the timeline of the sorts run so far to sort_trace.json when built with "make TRACE=1".
+// Open it in Perfetto (ui.perfetto.dev) to see where each sort spent its time.
+void WriteTraceIfEnabled() {
+#ifdef SORT_TRACE
+	if (writeSortTrace(string("sort_trace.json")))
+		cout << "Trace written to sort_trace.json" << endl;
+#endif
+}
 
 }  // namespace
 
@@ -216,7 +305,7 @@ int main(int argc, char **argv) {
   const string comparison_type = string(argv[3]);
 
   // Check to see if valid entry was entered
-  if (input_type != "random" && input_type != "sorted_small_to_large") {
+  if (input_type != "random" && input_type != "sorted_small_to_large" && input_type != "random_strings") {
     cout << "Invalid input type" << endl;
     return 0;
   }
@@ -237,6 +326,32 @@ int main(int argc, char **argv) {
   cout << "Running sorting algorithms: " << input_type << " " << input_size << " numbers " 
        << comparison_type << endl;
 
+  // Read the sort profile now, so the first timed sort does not
+  loadSortProfiles<int, string>();
+
+  // Strings use their own workload and also run the string sorting methods
+  if (input_type == "random_strings") {
+    vector<string> input_strings = GenerateRandomStrings(input_size);
+
+    vector<string> quicksort_test_strings_ = input_strings;
+    vector<string> heapsort_test_strings_ = input_strings;
+    vector<string> mergesort_test_strings_ = input_strings;
+    vector<string> adaptive_test_strings_ = input_strings;
+    vector<string> multikey_test_strings_ = input_strings;
+    vector<string> msd_test_strings_ = input_strings;
+    vector<string> lcp_test_strings_ = input_strings;
+
+    SortAndTestTiming("heapsort", heapsort_test_strings_, comparison_type);
+    SortAndTestTiming("mergesort", mergesort_test_strings_, comparison_type);
+    SortAndTestTiming("quicksort", quicksort_test_strings_, comparison_type);
+    SortAndTestTiming("adaptive sort", adaptive_test_strings_, comparison_type);
+    SortStringsAndTestTiming("multikey quicksort", multikey_test_strings_, comparison_type);
+    SortStringsAndTestTiming("msd radix sort", msd_test_strings_, comparison_type);
+    SortStringsAndTestTiming("lcp mergesort", lcp_test_strings_, comparison_type);
+    WriteTraceIfEnabled();
+    return 0;
+  }
+
   // Generate and fill vector based on user input
   vector<int> input_vector;
   if (input_type == "random") {
@@ -250,15 +365,18 @@ int main(int argc, char **argv) {
   vector<int> quicksort_test_vector_ = input_vector; 
   vector<int> heapsort_test_vector_ = input_vector; 
   vector<int> mergesort_test_vector_ = input_vector; 
-  string quick = "quicksort", merge = "mergesort", heap = "heapsort"; 
+  vector<int> adaptive_test_vector_ = input_vector; 
+  string quick = "quicksort", merge = "mergesort", heap = "heapsort", adaptive = "adaptive sort"; 
   
-  // Use all three sorting methods (quicksort, mergesort, heapsort) and sort the generated vector
+  // Use all three sorting methods (quicksort, mergesort, heapsort) and the adaptive sort, and sort the generated vector
   // based on user input. 
   // Time all these sorting methods and display the amount of time taken to complete each method
   // along with if it is sorted properly or not (Verification status). 
   SortAndTestTiming(heap, heapsort_test_vector_, comparison_type);
   SortAndTestTiming(merge, mergesort_test_vector_, comparison_type);
   SortAndTestTiming(quick, quicksort_test_vector_, comparison_type); 
+  SortAndTestTiming(adaptive, adaptive_test_vector_, comparison_type); 
+  WriteTraceIfEnabled();
 	 
   return 0;
 }
@@ -0,0 +1,159 @@
+/*
+	This is the test_top_k.cc file.
+	This code checks the streaming TopK heap ("TopK.h") against std::partial_sort:
+	for several k, including 0 and more than the input holds, and several heap
+	arities, the items it keeps, greatest first, must be the first k items of
+	the input sorted in descending order. Each case fills the TopK one item at a
+	time, in batches, and from parts merged together, as threads would.
+*/
+
+#include "Sort.h"
+#include "TopK.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Number of items given to each batch push
+const int BATCH_SIZE = 1000;
+
+// Number of parts the merged case splits its input into
+const int NUM_PARTS = 4;
+
+// Returns the @k greatest items of @input under @less_than, greatest first
+template <typename Comparator>
+vector<int> Expected(const vector<int>& input, int k, Comparator less_than) {
+	vector<int> a = input;
+	const int kept = max(0, min(k, int(a.size())));
+	partial_sort(a.begin(), a.begin() + kept, a.end(), [&](int x, int y) { return less_than(y, x); });
+	a.resize(kept);
+	return a;
+}
+
+// Returns the items kept by a TopK of @k and @arity pushed every item of @input one at a time
+template <typename Comparator>
+vector<int> PushEach(const vector<int>& input, int k, int arity, Comparator less_than) {
+	TopK<int, Comparator> top(k, less_than, arity);
+	for (int x : input)
+		top.push(x);
+	return top.sorted();
+}
+
+// Returns the items kept by a TopK of @k and @arity pushed @input in batches of BATCH_SIZE
+template <typename Comparator>
+vector<int> PushBatches(const vector<int>& input, int k, int arity, Comparator less_than) {
+	TopK<int, Comparator> top(k, less_than, arity);
+	for (size_t i = 0; i < input.size(); i += BATCH_SIZE)
+		top.push(vector<int>(input.begin() + i, input.begin() + min(input.size(), i + BATCH_SIZE)));
+	return top.sorted();
+}
+
+// Returns the items kept by merging NUM_PARTS TopKs of @k and @arity, each pushed one part of @input
+template <typename Comparator>
+vector<int> MergeParts(const vector<int>& input, int k, int arity, Comparator less_than) {
+	TopK<int, Comparator> top(k, less_than, arity);
+	for (int p = 0; p < NUM_PARTS; ++p) {
+		TopK<int, Comparator> part(k, less_than, arity);
+		part.push(vector<int>(input.begin() + input.size() * p / NUM_PARTS, input.begin() + input.size() * (p + 1) / NUM_PARTS));
+		top.merge(part);
+	}
+	return top.sorted();
+}
+
+// @ input: The items to keep the greatest of
+// @ k: Number of items kept
+// @ less_than: less<int>{} or greater<int>{}
+// @ failures: Number of failed checks so far
+// Function that checks every way of filling a TopK, with every arity, against std::partial_sort
+template <typename Comparator>
+void CheckTopK(const vector<int>& input, int k, Comparator less_than, int& failures) {
+	const vector<int> expected = Expected(input, k, less_than);
+	bool push_each = true, push_batches = true, merge_parts = true, full = true;
+	for (int arity : { 2, 3, 4, 8 }) {
+		push_each = PushEach(input, k, arity, less_than) == expected && push_each;
+		push_batches = PushBatches(input, k, arity, less_than) == expected && push_batches;
+		merge_parts = MergeParts(input, k, arity, less_than) == expected && merge_parts;
+
+		// Once k items have been pushed, the threshold is the least one kept
+		TopK<int, Comparator> top(k, less_than, arity);
+		top.push(input);
+		if (top.full() != (k > 0 && k <= int(input.size())) || (top.full() && top.threshold() != expected.back()))
+			full = false;
+	}
+
+	cout << "k = " << k << ": push " << push_each << ", batch " << push_batches << ", merge " << merge_parts
+		<< ", threshold " << full << endl;
+	failures += !push_each + !push_batches + !merge_parts + !full;
+}
+
+// Generates and returns random vector of size @size_of_vector.
+vector<int> GenerateRandomVector(size_t size_of_vector) {
+	vector<int> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back(rand());
+	return a;
+}
+
+// Generates and returns a vector of size @size_of_vector holding only 16 distinct values.
+vector<int> GenerateFewUniqueVector(size_t size_of_vector) {
+	vector<int> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back(rand() % 16);
+	return a;
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc != 4) {
+		cout << "Usage: " << argv[0] << "<input_type> <input_size> <comparison_type>" << endl;
+		return 0;
+	}
+
+	const string input_type = string(argv[1]);
+	const int input_size = stoi(string(argv[2]));
+	const string comparison_type = string(argv[3]);
+
+	// Check to see if valid entry was entered
+	if (input_type != "random" && input_type != "few_unique") {
+		cout << "Invalid input type" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (input_size <= 0) {
+		cout << "Invalid size" << endl;
+		return 0;
+	}
+
+	// Check to see if valid entry was entered
+	if (comparison_type != "less" && comparison_type != "greater") {
+		cout << "Invalid comparison type" << endl;
+		return 0;
+	}
+
+	cout << "Testing TopK: " << input_type << " " << input_size << " numbers " << comparison_type << endl;
+
+	const vector<int> input = input_type == "random" ? GenerateRandomVector(input_size) : GenerateFewUniqueVector(input_size);
+
+	int failures = 0;
+	for (int k : { 0, 1, 10, 1000, input_size - 1, input_size, input_size + 5 }) {
+		if (comparison_type == "less") {
+			CheckTopK(input, k, less<int>{}, failures);
+		}
+		else {
+			CheckTopK(input, k, greater<int>{}, failures);
+		}
+	}
+
+	cout << "---------------------------" << endl;
+	cout << "Failed checks: " << failures << endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+/*
+	This is the tune_sort.cc file.
+	This code calibrates the sort profile for this machine ("make calibrate").
+	For each element type it times quicksort, mergeSort, heapsort and sampleSort
+	with every candidate value of their cutoffs and thresholds, and writes the
+	fastest values to the profile file that the sorting routines load at startup.
+*/
+
+#include "Sort.h"
+#include "SampleSort.h"
+#include "SortTuning.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Number of items sorted when timing each candidate
+const int NUMERIC_TUNING_SIZE = 200000;
+const int STRING_TUNING_SIZE = 50000;
+
+// Number of times each candidate is timed; the fastest run counts
+const int TUNING_RUNS = 3;
+
+// The parallel grain is timed on inputs of this many items per hardware thread
+const int PARALLEL_TUNING_ITEMS[] = { 4096, 16384, 65536 };
+
+// @ input: Vector to sort; it is copied before every run
+// @ sorter: Function that sorts a vector in place
+// Function that returns the fastest of TUNING_RUNS runs of sorter on copies of input, in nanoseconds
+template <typename Comparable, typename Sorter>
+long long BestTime(const vector<Comparable>& input, Sorter sorter)
+{
+	// Assign alternative name (Time) to chrono::high_resolution_clock type for convenience
+	typedef chrono::high_resolution_clock Time;
+
+	long long best = -1;
+	for (int run = 0; run < TUNING_RUNS; ++run) {
+		vector<Comparable> a = input;
+		const auto begin = Time::now();
+		sorter(a);
+		const auto end = Time::now();
+		long long ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+		if (best < 0 || ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+// @ name: Name of the value being tuned
+// @ value: Reference to the value in the sort profile; left at the fastest candidate
+// @ candidates: Values to try
+// @ inputs: Vectors to sort; a candidate's time is the sum of their times
+// @ sorter: Function that sorts a vector in place using value
+// Function that times every candidate, prints the times, and keeps the fastest
+template <typename Comparable, typename Sorter>
+void TuneValue(const string& name, int& value, const vector<int>& candidates,
+	const vector<vector<Comparable>>& inputs, Sorter sorter)
+{
+	long long best = -1;
+	int best_value = value;
+
+	cout << "  " << name << ":";
+	for (int candidate : candidates) {
+		value = candidate;
+		long long ns = 0;
+		for (const vector<Comparable>& input : inputs)
+			ns += BestTime(input, sorter);
+		cout << " " << candidate << "=" << ns / 1000 << "us";
+		if (best < 0 || ns < best) {
+			best = ns;
+			best_value = candidate;
+		}
+	}
+	value = best_value;
+	cout << " -> " << best_value << endl;
+}
+
+// @ input: Random vector of the element type to tune
+// Function that tunes every value of the sort profile for the element type of input
+// and returns the tuned profile
+template <typename Comparable>
+SortProfile TuneType(const vector<Comparable>& input)
+{
+	SortProfile& profile = sortProfile<Comparable>();
+	cout << SortTypeName<Comparable>::name() << " (" << input.size() << " items)" << endl;
+	const vector<vector<Comparable>> inputs = { input };
+
+	TuneValue("insertion_cutoff", profile.insertionCutoff, { 4, 6, 8, 10, 12, 16, 20, 24, 32, 48, 64 }, inputs,
+		[](vector<Comparable>& a) { quicksort(a, less<Comparable>{}); });
+
+	TuneValue("merge_block", profile.mergeBlock, { 1, 4, 8, 12, 16, 24, 32, 48, 64 }, inputs,
+		[](vector<Comparable>& a) { mergeSort(a, less<Comparable>{}); });
+
+	TuneValue("heap_arity", profile.heapArity, { 2, 3, 4, 6, 8 }, inputs,
+		[](vector<Comparable>& a) { heapsort(a, less<Comparable>{}); });
+
+	// The grain only matters with several threads, and only where n / grain is below the
+	// number of threads. Time a few sizes around that point, so the candidates differ
+	// in how many threads they use on at least some of them
+	const int num_threads = thread::hardware_concurrency();
+	if (num_threads > 1) {
+		vector<vector<Comparable>> parallel_inputs;
+		for (int items : PARALLEL_TUNING_ITEMS) {
+			size_t size = max(size_t(num_threads) * items, size_t(SAMPLE_SORT_CUTOFF));
+			vector<Comparable> parallel_input;
+			while (parallel_input.size() < size)
+				parallel_input.insert(parallel_input.end(), input.begin(),
+					input.begin() + min(input.size(), size - parallel_input.size()));
+			parallel_inputs.push_back(parallel_input);
+		}
+		TuneValue("parallel_grain", profile.parallelGrain, { 2048, 4096, 8192, 16384, 32768, 65536 }, parallel_inputs,
+			[num_threads](vector<Comparable>& a) { sampleSort(a, less<Comparable>{}, num_threads); });
+	}
+	else {
+		cout << "  parallel_grain: single hardware thread, keeping " << profile.parallelGrain << endl;
+	}
+
+	return profile;
+}
+
+// Generates and returns random vector of size @size_of_vector.
+template <typename Comparable>
+vector<Comparable> GenerateRandomVector(size_t size_of_vector) {
+	vector<Comparable> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back(Comparable(rand()) + Comparable(rand()) / Comparable(RAND_MAX));
+	return a;
+}
+
+// Generates and returns vector of @size_of_vector random strings.
+vector<string> GenerateRandomStrings(size_t size_of_vector) {
+	vector<string> a;
+	for (size_t i = 0; i < size_of_vector; ++i)
+		a.push_back("key/" + to_string(rand()) + "/" + to_string(rand()));
+	return a;
+}
+
+}  // namespace
+
+// Main function
+int main(int argc, char** argv) {
+
+	// Check to make sure all arguments were inputted
+	if (argc > 2) {
+		cout << "Usage: " << argv[0] << " [profile_path]" << endl;
+		return 0;
+	}
+
+	// Ignore any existing profile, so it can't affect the values that aren't being tuned
+	const string path = argc == 2 ? string(argv[1]) : sortProfilePath();
+	setenv("SORT_PROFILE", "/dev/null", 1);
+
+	cout << "Calibrating sort profile" << endl;
+
+	map<string, SortProfile> profiles;
+	profiles[SortTypeName<int>::name()] = TuneType(GenerateRandomVector<int>(NUMERIC_TUNING_SIZE));
+	profiles[SortTypeName<long long>::name()] = TuneType(GenerateRandomVector<long long>(NUMERIC_TUNING_SIZE));
+	profiles[SortTypeName<double>::name()] = TuneType(GenerateRandomVector<double>(NUMERIC_TUNING_SIZE));
+	profiles[SortTypeName<string>::name()] = TuneType(GenerateRandomStrings(STRING_TUNING_SIZE));
+
+	if (!writeSortProfiles(path, profiles)) {
+		cout << "Cannot write " << path << endl;
+		return 1;
+	}
+	cout << "Wrote " << path << endl;
+
+	return 0;
+}